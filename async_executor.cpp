@@ -0,0 +1,153 @@
+#include "async_executor.hpp"
+
+#include <algorithm>
+
+namespace sql {
+
+	void cancellation_token::cancel() {
+		std::lock_guard<std::mutex> lock(state_->mutex);
+		state_->cancelled = true;
+		for (sqlite* db : state_->running_on) {
+			db->interrupt();
+		}
+	}
+
+	bool cancellation_token::cancelled() const {
+		std::lock_guard<std::mutex> lock(state_->mutex);
+		return state_->cancelled;
+	}
+
+	async_executor::async_executor() : queue_capacity_(0), accepting_(false) {}
+
+	async_executor::~async_executor() {
+		close();
+	}
+
+	int async_executor::open(const std::string& filename, size_t workers, size_t queue_capacity, const open_options& options) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		// with no workers queued operations would never run and their futures never be ready
+		if (accepting_ || !workers_.empty() || workers == 0) { return SQLITE_MISUSE; }
+
+		std::vector<std::unique_ptr<sqlite>> connections;
+		for (size_t i = 0; i < workers; ++i) {
+			auto db = std::make_unique<sqlite>();
+			int rc = db->open(filename, options);
+			if (rc != SQLITE_OK) {
+				last_error_ = db->get_last_error_description();
+				return rc;
+			}
+			connections.push_back(std::move(db));
+		}
+
+		connections_ = std::move(connections);
+		queue_capacity_ = queue_capacity;
+		accepting_ = true;
+		for (auto& db : connections_) {
+			workers_.emplace_back(&async_executor::worker_loop, this, std::ref(*db));
+		}
+		return SQLITE_OK;
+	}
+
+	void async_executor::close() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			accepting_ = false;
+		}
+		work_available_.notify_all();
+
+		for (auto& worker : workers_) {
+			worker.join();
+		}
+		workers_.clear();
+		connections_.clear();
+	}
+
+	int async_executor::post(std::function<void(sqlite*)> run, cancellation_token token) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!accepting_) { return SQLITE_MISUSE; }
+			if (queue_.size() >= queue_capacity_) { return SQLITE_BUSY; }
+
+			queue_.push_back({ std::move(run), std::move(token) });
+		}
+		work_available_.notify_one();
+		return SQLITE_OK;
+	}
+
+	void async_executor::worker_loop(sqlite& db) {
+		for (;;) {
+			queued_job next;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				work_available_.wait(lock, [this] { return !queue_.empty() || !accepting_; });
+
+				// queued work is still completed after close
+				if (queue_.empty()) { return; }
+
+				next = std::move(queue_.front());
+				queue_.pop_front();
+			}
+
+			auto& state = *next.token.state_;
+			bool cancelled;
+			{
+				std::lock_guard<std::mutex> lock(state.mutex);
+				cancelled = state.cancelled;
+				if (!cancelled) {
+					state.running_on.push_back(&db);
+				}
+			}
+
+			// a job from post has no one to report an exception to, and letting it
+			// escape would end the worker with std::terminate
+			try {
+				next.run(cancelled ? nullptr : &db);
+			}
+			catch (...) {}
+
+			if (!cancelled) {
+				std::lock_guard<std::mutex> lock(state.mutex);
+				state.running_on.erase(std::find(state.running_on.begin(), state.running_on.end(), &db));
+			}
+		}
+	}
+
+	std::future<int> async_executor::insert_into(std::string table_name, std::vector<column_values> columns,
+		cancellation_token token) {
+		return run_async<int>([table_name = std::move(table_name), columns = std::move(columns)](sqlite& db) {
+			return db.insert_into(table_name, columns.begin(), columns.end());
+		}, [](int rc) { return rc; }, std::move(token));
+	}
+
+	std::future<int> async_executor::update(std::string table_name, std::vector<column_values> columns,
+		std::string where_clause, std::vector<where_binding> where_bindings, cancellation_token token) {
+		return run_async<int>([table_name = std::move(table_name), columns = std::move(columns),
+			where_clause = std::move(where_clause), where_bindings = std::move(where_bindings)](sqlite& db) {
+			return db.update(table_name, columns.begin(), columns.end(), where_clause, where_bindings.begin(), where_bindings.end());
+		}, [](int rc) { return rc; }, std::move(token));
+	}
+
+	std::future<int> async_executor::delete_from(std::string table_name, std::string where_clause,
+		std::vector<where_binding> where_bindings, cancellation_token token) {
+		return run_async<int>([table_name = std::move(table_name), where_clause = std::move(where_clause),
+			where_bindings = std::move(where_bindings)](sqlite& db) {
+			return db.delete_from(table_name, where_clause, where_bindings.begin(), where_bindings.end());
+		}, [](int rc) { return rc; }, std::move(token));
+	}
+
+	std::future<select_result> async_executor::select_columns(std::string table_name, std::vector<std::string> column_names,
+		std::string where_clause, std::vector<where_binding> where_bindings, cancellation_token token) {
+		return run_async<select_result>([table_name = std::move(table_name), column_names = std::move(column_names),
+			where_clause = std::move(where_clause), where_bindings = std::move(where_bindings)](sqlite& db) {
+			select_result result;
+			result.rc = db.select_columns(table_name, column_names.begin(), column_names.end(),
+				where_clause, where_bindings.begin(), where_bindings.end(), result.rows);
+			return result;
+		}, [](int rc) { select_result result; result.rc = rc; return result; }, std::move(token));
+	}
+
+	std::future<int> async_executor::submit(std::function<int(sqlite&)> operation, cancellation_token token) {
+		return run_async<int>(std::move(operation), [](int rc) { return rc; }, std::move(token));
+	}
+
+} // sql
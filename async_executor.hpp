@@ -0,0 +1,166 @@
+/*
+sqlite - a thin c++ wrapper of sqlite c library
+version 0.0.1
+https://github.com/arcomber/sqlite_cpp
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2021 Angus Comber
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ASYNC_EXECUTOR_HPP_
+#define ASYNC_EXECUTOR_HPP_
+
+#include "sqlite.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sql {
+
+	/* rows and result code of an asynchronous select */
+	struct select_result {
+		int rc = SQLITE_OK;
+		std::vector<std::map<std::string, sqlite_data_type>> rows;
+	};
+
+	/* cancels one or more submitted operations. an operation not yet started never runs and
+	completes with SQLITE_INTERRUPT, a running operation is interrupted with sqlite3_interrupt.
+	copies share the same state */
+	class cancellation_token {
+	public:
+		cancellation_token() : state_(std::make_shared<state>()) {}
+
+		void cancel();
+		bool cancelled() const;
+
+	private:
+		friend class async_executor;
+
+		struct state {
+			std::mutex mutex;
+			bool cancelled = false;
+			// connections running the token's operations, a shared token may have several at once
+			std::vector<sqlite*> running_on;
+		};
+		std::shared_ptr<state> state_;
+	};
+
+	/*
+	runs sqlite operations on a pool of worker threads, each owning its own connection, and
+	returns std::future results so the submitting thread does not block on sqlite3_step.
+	operations take their arguments by value as they run after the call returns.
+	the submission queue is bounded. when it is full, or the executor is not open, the
+	returned future is ready at once with SQLITE_BUSY / SQLITE_MISUSE instead of blocking.
+	*/
+	class async_executor {
+	public:
+		async_executor();
+		~async_executor();
+
+		async_executor(const async_executor&) = delete;
+		async_executor& operator=(const async_executor&) = delete;
+
+		/* open one connection per worker to filename and start the workers. queue_capacity
+		is the maximum number of operations waiting for a worker. SQLITE_MISUSE if workers is 0 */
+		int open(const std::string& filename, size_t workers, size_t queue_capacity,
+			const open_options& options = open_options());
+
+		/* stop accepting work, wait for queued operations to finish and close connections */
+		void close();
+
+		std::future<int> insert_into(std::string table_name, std::vector<column_values> columns,
+			cancellation_token token = cancellation_token());
+
+		std::future<int> update(std::string table_name, std::vector<column_values> columns,
+			std::string where_clause, std::vector<where_binding> where_bindings,
+			cancellation_token token = cancellation_token());
+
+		std::future<int> delete_from(std::string table_name, std::string where_clause,
+			std::vector<where_binding> where_bindings, cancellation_token token = cancellation_token());
+
+		/* an empty column_names selects * */
+		std::future<select_result> select_columns(std::string table_name, std::vector<std::string> column_names,
+			std::string where_clause, std::vector<where_binding> where_bindings,
+			cancellation_token token = cancellation_token());
+
+		/* run any operation on a worker's connection, the future receives its return code.
+		an exception thrown by operation is stored in the future, as for the other operations */
+		std::future<int> submit(std::function<int(sqlite&)> operation, cancellation_token token = cancellation_token());
+
+		/* lowest level submission. job is called on a worker with its connection, or with nullptr
+		if token was cancelled before it started. returns SQLITE_OK, SQLITE_BUSY if the queue is
+		full or SQLITE_MISUSE if not open, in which case job is never called. an exception
+		escaping job has nowhere to go and is discarded, the worker carries on */
+		int post(std::function<void(sqlite*)> job, cancellation_token token = cancellation_token());
+
+		size_t worker_count() const { return workers_.size(); }
+
+		/* error text from the last failed open */
+		const std::string& get_last_error_description() const { return last_error_; }
+
+	private:
+		struct queued_job {
+			std::function<void(sqlite*)> run;
+			cancellation_token token;
+		};
+
+		std::mutex mutex_;
+		std::condition_variable work_available_;
+		std::deque<queued_job> queue_;
+		size_t queue_capacity_;
+		bool accepting_;
+		std::vector<std::unique_ptr<sqlite>> connections_;
+		std::vector<std::thread> workers_;
+		std::string last_error_;
+
+		void worker_loop(sqlite& db);
+
+		/* queue operation returning result_type, where failure_value(rc) is the result if it never runs */
+		template <typename result_type, typename operation_type, typename failure_type>
+		std::future<result_type> run_async(operation_type operation, failure_type failure_value, cancellation_token token) {
+			auto promise = std::make_shared<std::promise<result_type>>();
+			std::future<result_type> result = promise->get_future();
+
+			int rc = post([promise, operation = std::move(operation), failure_value](sqlite* db) mutable {
+				try {
+					promise->set_value(db ? operation(*db) : failure_value(SQLITE_INTERRUPT));
+				}
+				catch (...) {
+					// eg std::bad_alloc reading rows, get() rethrows it on the caller's thread
+					promise->set_exception(std::current_exception());
+				}
+			}, std::move(token));
+
+			if (rc != SQLITE_OK) {
+				promise->set_value(failure_value(rc));
+			}
+			return result;
+		}
+	};
+
+} // sql
+
+#endif // ASYNC_EXECUTOR_HPP_
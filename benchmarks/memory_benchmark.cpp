@@ -0,0 +1,179 @@
+/*
+	compares the settings of memory_config.hpp with sqlite's defaults on the insert and
+	select paths of sqlite.hpp. the settings are process wide so each run measures one
+	configuration, and each mode but all changes a single setting so its effect can be
+	told apart from the others:
+
+	./memory_benchmark default      sqlite's defaults
+	./memory_benchmark pool         the pool allocator only
+	./memory_benchmark memstatus    memory statistics turned off only
+	./memory_benchmark lookaside    128 x 512 lookaside only
+	./memory_benchmark all          all three together
+
+	an optional second argument sets the number of threads.
+
+	every thread works on its own database file, so any difference in scaling comes
+	from the memory settings rather than from locking in sqlite
+*/
+#include "sqlite.hpp"
+#include "memory_config.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+	const int rows_per_thread = 20000;
+	const int select_repeats = 10;
+
+	// error is empty if every call succeeded, otherwise the timings are not meaningful
+	struct timings {
+		double insert_ms = 0;
+		double select_ms = 0;
+		std::string error;
+	};
+
+	timings failed(const std::string& what, int rc) {
+		timings result;
+		result.error = what + " returned " + std::to_string(rc);
+		return result;
+	}
+
+	double elapsed_ms(std::chrono::steady_clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+	}
+
+	timings run_thread(int thread_number) {
+		timings result;
+		const std::string filename = "memory_benchmark_" + std::to_string(thread_number) + ".db";
+		std::remove(filename.c_str());
+
+		// the wrapper has no DDL call, so create the table through the C api
+		sqlite3* raw = nullptr;
+		int rc = sqlite3_open(filename.c_str(), &raw);
+		if (rc == SQLITE_OK) {
+			rc = sqlite3_exec(raw, "CREATE TABLE calls(timestamp DATETIME DEFAULT CURRENT_TIMESTAMP, callerid TEXT, contactid INTEGER);", 0, 0, 0);
+		}
+		sqlite3_close(raw);
+		if (rc != SQLITE_OK) { return failed("CREATE TABLE", rc); }
+
+		// no syncing, so the timings are dominated by the cpu and allocator
+		sql::open_options options;
+		options.journal_mode = sql::open_options::journal::memory;
+		options.synchronous = sql::open_options::sync::off;
+		sql::sqlite db;
+		rc = db.open(filename, options);
+		if (rc != SQLITE_OK) { return failed("open", rc); }
+
+		const std::vector<std::vector<sql::column_values>> rows = [thread_number] {
+			std::vector<std::vector<sql::column_values>> made;
+			made.reserve(rows_per_thread);
+			for (int i = 0; i < rows_per_thread; ++i) {
+				made.push_back({ {"callerid", "0775512" + std::to_string(i % 1000)}, {"contactid", thread_number * rows_per_thread + i} });
+			}
+			return made;
+		}();
+
+		// one insert_into per row, in a single transaction to keep commits out of the timing
+		auto started = std::chrono::steady_clock::now();
+		sql::transaction txn(db);
+		rc = txn.begin();
+		if (rc != SQLITE_OK) { return failed("BEGIN", rc); }
+		for (const auto& row : rows) {
+			rc = db.insert_into("calls", row.begin(), row.end());
+			if (rc != SQLITE_OK) { return failed("insert_into: " + db.get_last_error_description(), rc); }
+		}
+		rc = txn.commit();
+		if (rc != SQLITE_OK) { return failed("COMMIT", rc); }
+		result.insert_ms = elapsed_ms(started);
+
+		const std::vector<std::string> columns{ "callerid", "contactid" };
+		const std::vector<sql::where_binding> bindings;
+		started = std::chrono::steady_clock::now();
+		for (int i = 0; i < select_repeats; ++i) {
+			std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+			rc = db.select_columns("calls", columns.begin(), columns.end(), "", bindings.begin(), bindings.end(), results);
+			if (rc != SQLITE_OK) { return failed("select_columns: " + db.get_last_error_description(), rc); }
+			if (results.size() != static_cast<size_t>(rows_per_thread)) {
+				return failed("select_columns row count " + std::to_string(results.size()), rc);
+			}
+		}
+		result.select_ms = elapsed_ms(started);
+
+		db.close();
+		std::remove(filename.c_str());
+		return result;
+	}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+	const std::string mode = argc > 1 ? argv[1] : "default";
+	const bool all = mode == "all";
+	const bool pool = all || mode == "pool";
+
+	sql::memory_options options;
+	options.pool_allocator = pool;
+	if (all || mode == "memstatus") {
+		options.memory_status = false;
+	}
+	if (all || mode == "lookaside") {
+		options.lookaside_slot_size = 128;
+		options.lookaside_slot_count = 512;
+	}
+	if (!all && !pool && mode != "default" && mode != "memstatus" && mode != "lookaside") {
+		std::cerr << "usage: memory_benchmark [default|pool|memstatus|lookaside|all] [threads]\n";
+		return 1;
+	}
+
+	// hardware_concurrency is 0 when it cannot be determined
+	int threads = argc > 2 ? std::stoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+	if (threads <= 0) {
+		threads = 1;
+	}
+
+	int rc = sql::configure_memory(options);
+	if (rc != SQLITE_OK) {
+		std::cerr << "configure_memory returned " << rc << '\n';
+		return 1;
+	}
+
+	std::vector<timings> results(threads);
+	std::vector<std::thread> workers;
+	const auto started = std::chrono::steady_clock::now();
+	for (int t = 0; t < threads; ++t) {
+		workers.emplace_back([&results, t] { results[t] = run_thread(t); });
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	const double wall_ms = elapsed_ms(started);
+
+	// a failed thread would be averaged in as a fast one
+	double insert_ms = 0, select_ms = 0;
+	for (size_t t = 0; t < results.size(); ++t) {
+		if (!results[t].error.empty()) {
+			std::cerr << mode << ": thread " << t << ": " << results[t].error << '\n';
+			return 1;
+		}
+	}
+	for (const timings& t : results) {
+		insert_ms += t.insert_ms;
+		select_ms += t.select_ms;
+	}
+
+	std::cout << mode << ", " << threads << " threads\n"
+		<< "  insert: " << insert_ms / threads << " ms per thread for " << rows_per_thread << " rows\n"
+		<< "  select: " << select_ms / threads << " ms per thread for " << select_repeats << " x " << rows_per_thread << " rows\n"
+		<< "  wall:   " << wall_ms << " ms\n";
+	if (pool) {
+		const sql::pool_statistics statistics = sql::get_pool_statistics();
+		std::cout << "  pool malloc calls: " << statistics.malloc_calls
+			<< ", shared list transfers: " << statistics.shared_list_transfers << '\n';
+	}
+	return 0;
+}
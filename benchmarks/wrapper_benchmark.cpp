@@ -0,0 +1,463 @@
+/*
+	measures design requirement 1, the wrapper "must not be significantly slower than using
+	the c library calls directly". each wrapper operation is timed against a hand written
+	sqlite3_* equivalent doing the same statements on identical data, over several row counts,
+	column counts and blob sizes. results are written as JSON to stdout, or to the file named
+	by the first argument:
+
+	./wrapper_benchmark results.json
+
+	an op is one call of the operation: one row for insert_into, update and delete_from, one
+	whole result set for select_star and select_columns. allocations count both C++ operator
+	new and sqlite's own mallocs. overhead_ratio is wrapper ns_per_op over raw ns_per_op.
+	update and delete_from build their where_binding vectors per call, as a caller would.
+	every case runs repetitions times and the fastest run is reported. a failed call, or wrapper
+	and raw results which differ, stop the benchmark with exit code 1.
+*/
+#include "sqlite.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+	std::atomic<uint64_t> allocation_count(0);
+
+	// sqlite's mallocs, counted by wrapping the allocator sqlite would otherwise use
+	sqlite3_mem_methods default_methods;
+
+	void* counting_malloc(int size) {
+		allocation_count.fetch_add(1, std::memory_order_relaxed);
+		return default_methods.xMalloc(size);
+	}
+
+	void* counting_realloc(void* p, int size) {
+		allocation_count.fetch_add(1, std::memory_order_relaxed);
+		return default_methods.xRealloc(p, size);
+	}
+
+	void counting_free(void* p) { default_methods.xFree(p); }
+	int counting_size(void* p) { return default_methods.xSize(p); }
+	int counting_roundup(int size) { return default_methods.xRoundup(size); }
+	int counting_init(void* data) { return default_methods.xInit(data); }
+	void counting_shutdown(void* data) { default_methods.xShutdown(data); }
+
+	sqlite3_mem_methods counting_methods = {
+		counting_malloc, counting_free, counting_realloc, counting_size, counting_roundup,
+		counting_init, counting_shutdown, nullptr
+	};
+
+} // anonymous namespace
+
+// gcc inlines these replacements into their callers and then reports the free of memory from
+// operator new as a mismatch, which it is not since both are replaced together here
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1)) { return p; }
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+
+namespace {
+
+	const char* const database_file = "wrapper_benchmark.db";
+	const int repetitions = 3;
+	const int select_calls = 5;
+
+	struct bench_case {
+		int rows;
+		int columns;      // c0 INTEGER then TEXT columns c1...
+		int blob_bytes;   // 0 for no payload BLOB column
+	};
+
+	struct measurement {
+		double ns_per_op = 0;
+		double allocations_per_op = 0;
+	};
+
+	// fastest of the repetitions, with its allocations
+	void keep_best(measurement& best, double ns, uint64_t allocations, int ops) {
+		const double ns_per_op = ns / ops;
+		if (best.ns_per_op == 0 || ns_per_op < best.ns_per_op) {
+			best.ns_per_op = ns_per_op;
+			best.allocations_per_op = static_cast<double>(allocations) / ops;
+		}
+	}
+
+	// time one run of body, which performs ops operations
+	template <typename operation>
+	void measure(measurement& best, int ops, operation body) {
+		const uint64_t allocations_before = allocation_count.load();
+		const auto started = std::chrono::steady_clock::now();
+		body();
+		const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+		keep_best(best, ns, allocation_count.load() - allocations_before, ops);
+	}
+
+	std::string text_value(int row, int column) {
+		std::string value = "r" + std::to_string(row) + "c" + std::to_string(column);
+		value.resize(16, '.');
+		return value;
+	}
+
+	std::string create_sql(const std::string& table, const bench_case& c) {
+		std::string sql = "DROP TABLE IF EXISTS " + table + "; CREATE TABLE " + table + " (c0 INTEGER";
+		for (int col = 1; col < c.columns; ++col) {
+			sql += ", c" + std::to_string(col) + " TEXT";
+		}
+		if (c.blob_bytes > 0) {
+			sql += ", payload BLOB";
+		}
+		return sql + ");";
+	}
+
+	void exec(sqlite3* db, const std::string& sql) {
+		char* error = nullptr;
+		if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &error) != SQLITE_OK) {
+			std::cerr << sql << ": " << (error ? error : "") << '\n';
+			sqlite3_free(error);
+			std::exit(1);
+		}
+	}
+
+	sqlite3_stmt* prepare(sqlite3* db, const std::string& sql) {
+		sqlite3_stmt* stmt = nullptr;
+		if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+			std::cerr << sql << ": " << sqlite3_errmsg(db) << '\n';
+			std::exit(1);
+		}
+		return stmt;
+	}
+
+	// a timed call which failed would look like a speed up, so every run is checked and any
+	// failure or difference between wrapper and raw results ends the benchmark
+	void check(bool ok, const bench_case& c, const char* operation, const std::string& what) {
+		if (!ok) {
+			std::cerr << operation << " rows=" << c.rows << " columns=" << c.columns << " blob_bytes=" << c.blob_bytes
+				<< ": " << what << '\n';
+			std::exit(1);
+		}
+	}
+
+	int64_t query_int64(sqlite3* db, const std::string& sql) {
+		sqlite3_stmt* stmt = prepare(db, sql);
+		int64_t value = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : -1;
+		sqlite3_finalize(stmt);
+		return value;
+	}
+
+	// the same query on both tables must give the same answer
+	void check_tables_match(sqlite3* db, const bench_case& c, const char* operation, const std::string& query, int64_t expected) {
+		const int64_t wrapper = query_int64(db, query + " FROM bench_wrapper;");
+		const int64_t raw = query_int64(db, query + " FROM bench_raw;");
+		check(wrapper == raw && wrapper == expected, c, operation, query + " gave wrapper " + std::to_string(wrapper) +
+			", raw " + std::to_string(raw) + ", expected " + std::to_string(expected));
+	}
+
+	// sink for values read by the raw selects so the reads are not optimised away
+	volatile size_t bytes_read = 0;
+
+	void read_raw_row(sqlite3_stmt* stmt) {
+		size_t total = 0;
+		const int count = sqlite3_column_count(stmt);
+		for (int col = 0; col < count; ++col) {
+			switch (sqlite3_column_type(stmt, col)) {
+			case SQLITE_INTEGER: total += static_cast<size_t>(sqlite3_column_int64(stmt, col)); break;
+			case SQLITE_FLOAT: total += static_cast<size_t>(sqlite3_column_double(stmt, col)); break;
+			case SQLITE_TEXT: sqlite3_column_text(stmt, col); total += sqlite3_column_bytes(stmt, col); break;
+			case SQLITE_BLOB: sqlite3_column_blob(stmt, col); total += sqlite3_column_bytes(stmt, col); break;
+			default: break;
+			}
+		}
+		bytes_read = bytes_read + total;
+	}
+
+	// step stmt to the end reading every column. returns the number of rows or -1 on error
+	int64_t read_raw_rows(sqlite3_stmt* stmt) {
+		int64_t rows = 0;
+		int rc;
+		while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+			read_raw_row(stmt);
+			++rows;
+		}
+		return sqlite3_reset(stmt) == SQLITE_OK && rc == SQLITE_DONE ? rows : -1;
+	}
+
+	struct case_result {
+		bench_case c;
+		const char* operation;
+		measurement wrapper;
+		measurement raw;
+	};
+
+	void run_case(const bench_case& c, sql::sqlite& wrapper_db, sqlite3* raw_db, std::vector<case_result>& results) {
+		exec(raw_db, create_sql("bench_wrapper", c));
+		exec(raw_db, create_sql("bench_raw", c));
+
+		// identical data for both, built outside the timed regions
+		const std::vector<uint8_t> payload(static_cast<size_t>(c.blob_bytes), 0xAB);
+		std::vector<std::vector<sql::column_values>> rows(c.rows);
+		for (int row = 0; row < c.rows; ++row) {
+			rows[row].push_back({ "c0", row });
+			for (int col = 1; col < c.columns; ++col) {
+				rows[row].push_back({ "c" + std::to_string(col), text_value(row, col) });
+			}
+			if (c.blob_bytes > 0) {
+				rows[row].push_back({ "payload", payload });
+			}
+		}
+
+		std::string insert_sql = "INSERT INTO bench_raw (c0";
+		std::string values = ") VALUES (?";
+		for (int col = 1; col < c.columns; ++col) {
+			insert_sql += ",c" + std::to_string(col);
+			values += ",?";
+		}
+		if (c.blob_bytes > 0) {
+			insert_sql += ",payload";
+			values += ",?";
+		}
+		insert_sql += values + ");";
+
+		sqlite3_stmt* raw_insert = prepare(raw_db, insert_sql);
+		sqlite3_stmt* raw_update = prepare(raw_db, "UPDATE bench_raw SET c0=? WHERE rowid=?;");
+		sqlite3_stmt* raw_select_star = prepare(raw_db, "SELECT * FROM bench_raw;");
+		sqlite3_stmt* raw_select_columns = prepare(raw_db, "SELECT c0 FROM bench_raw WHERE c0>=?;");
+		sqlite3_stmt* raw_delete = prepare(raw_db, "DELETE FROM bench_raw WHERE rowid=?;");
+
+		case_result insert{ c, "insert_into", {}, {} };
+		case_result update{ c, "update", {}, {} };
+		case_result select_star{ c, "select_star", {}, {} };
+		case_result select_columns{ c, "select_columns", {}, {} };
+		case_result remove{ c, "delete_from", {}, {} };
+
+		const std::vector<std::string> selected_columns{ "c0" };
+		const std::vector<sql::where_binding> half{ {"low", c.rows / 2} };
+
+		const int64_t rows_selected = c.rows - c.rows / 2 + 1;   // c0 >= rows / 2 once updated to 1 ... rows
+
+		for (int rep = 0; rep < repetitions; ++rep) {
+			// each operation runs in one transaction for both, so commits are not measured
+			sql::transaction txn(wrapper_db);
+			// failed calls and rows read, counted in the timed loops and checked after them
+			int wrapper_failures = 0;
+			int raw_failures = 0;
+			int64_t wrapper_rows = 0;
+			int64_t raw_rows = 0;
+
+			check(txn.begin() == SQLITE_OK, c, "insert_into", "BEGIN failed");
+			measure(insert.wrapper, c.rows, [&] {
+				for (const auto& row : rows) {
+					wrapper_failures += wrapper_db.insert_into("bench_wrapper", row.begin(), row.end()) != SQLITE_OK;
+				}
+			});
+			check(txn.commit() == SQLITE_OK, c, "insert_into", "COMMIT failed");
+
+			exec(raw_db, "BEGIN;");
+			measure(insert.raw, c.rows, [&] {
+				for (int row = 0; row < c.rows; ++row) {
+					sqlite3_bind_int(raw_insert, 1, row);
+					for (int col = 1; col < c.columns; ++col) {
+						const std::string& text = std::get<std::string>(rows[row][col].column_value);
+						sqlite3_bind_text64(raw_insert, col + 1, text.data(), text.size(), SQLITE_STATIC, SQLITE_UTF8);
+					}
+					if (c.blob_bytes > 0) {
+						sqlite3_bind_blob64(raw_insert, c.columns + 1, payload.data(), payload.size(), SQLITE_STATIC);
+					}
+					raw_failures += sqlite3_step(raw_insert) != SQLITE_DONE;
+					sqlite3_reset(raw_insert);
+				}
+			});
+			exec(raw_db, "COMMIT;");
+			check(wrapper_failures == 0 && raw_failures == 0, c, "insert_into", "insert failed");
+			check_tables_match(raw_db, c, "insert_into", "SELECT count(*)", c.rows);
+
+			check(txn.begin() == SQLITE_OK, c, "update", "BEGIN failed");
+			measure(update.wrapper, c.rows, [&] {
+				for (int row = 0; row < c.rows; ++row) {
+					const std::vector<sql::column_values> set{ {"c0", row + 1} };
+					const std::vector<sql::where_binding> where{ {"rowid", row + 1} };
+					wrapper_failures += wrapper_db.update("bench_wrapper", set.begin(), set.end(), "WHERE rowid=:rowid",
+						where.begin(), where.end()) != SQLITE_OK;
+				}
+			});
+			check(txn.commit() == SQLITE_OK, c, "update", "COMMIT failed");
+
+			exec(raw_db, "BEGIN;");
+			measure(update.raw, c.rows, [&] {
+				for (int row = 0; row < c.rows; ++row) {
+					sqlite3_bind_int(raw_update, 1, row + 1);
+					sqlite3_bind_int(raw_update, 2, row + 1);
+					raw_failures += sqlite3_step(raw_update) != SQLITE_DONE;
+					sqlite3_reset(raw_update);
+				}
+			});
+			exec(raw_db, "COMMIT;");
+			check(wrapper_failures == 0 && raw_failures == 0, c, "update", "update failed");
+			// c0 went from 0 ... rows - 1 to 1 ... rows
+			check_tables_match(raw_db, c, "update", "SELECT sum(c0)", static_cast<int64_t>(c.rows) * (c.rows + 1) / 2);
+
+			measure(select_star.wrapper, select_calls, [&] {
+				for (int call = 0; call < select_calls; ++call) {
+					std::vector<std::map<std::string, sql::sqlite_data_type>> selected;
+					wrapper_failures += wrapper_db.select_star("bench_wrapper", selected) != SQLITE_OK;
+					wrapper_rows += selected.size();
+				}
+			});
+
+			measure(select_star.raw, select_calls, [&] {
+				for (int call = 0; call < select_calls; ++call) {
+					const int64_t read = read_raw_rows(raw_select_star);
+					raw_failures += read < 0;
+					raw_rows += read;
+				}
+			});
+			check(wrapper_failures == 0 && raw_failures == 0, c, "select_star", "select failed");
+			check(wrapper_rows == raw_rows && raw_rows == select_calls * static_cast<int64_t>(c.rows), c, "select_star",
+				"selected wrapper " + std::to_string(wrapper_rows) + " rows, raw " + std::to_string(raw_rows));
+			wrapper_rows = raw_rows = 0;
+
+			measure(select_columns.wrapper, select_calls, [&] {
+				for (int call = 0; call < select_calls; ++call) {
+					std::vector<std::map<std::string, sql::sqlite_data_type>> selected;
+					wrapper_failures += wrapper_db.select_columns("bench_wrapper", selected_columns.begin(), selected_columns.end(),
+						"WHERE c0>=:low", half.begin(), half.end(), selected) != SQLITE_OK;
+					wrapper_rows += selected.size();
+				}
+			});
+
+			measure(select_columns.raw, select_calls, [&] {
+				for (int call = 0; call < select_calls; ++call) {
+					sqlite3_bind_int(raw_select_columns, 1, c.rows / 2);
+					const int64_t read = read_raw_rows(raw_select_columns);
+					raw_failures += read < 0;
+					raw_rows += read;
+				}
+			});
+			check(wrapper_failures == 0 && raw_failures == 0, c, "select_columns", "select failed");
+			check(wrapper_rows == raw_rows && raw_rows == select_calls * rows_selected, c, "select_columns",
+				"selected wrapper " + std::to_string(wrapper_rows) + " rows, raw " + std::to_string(raw_rows));
+
+			check(txn.begin() == SQLITE_OK, c, "delete_from", "BEGIN failed");
+			measure(remove.wrapper, c.rows, [&] {
+				for (int row = 0; row < c.rows; ++row) {
+					const std::vector<sql::where_binding> where{ {"rowid", row + 1} };
+					wrapper_failures += wrapper_db.delete_from("bench_wrapper", "WHERE rowid=:rowid",
+						where.begin(), where.end()) != SQLITE_OK;
+				}
+			});
+			check(txn.commit() == SQLITE_OK, c, "delete_from", "COMMIT failed");
+
+			exec(raw_db, "BEGIN;");
+			measure(remove.raw, c.rows, [&] {
+				for (int row = 0; row < c.rows; ++row) {
+					sqlite3_bind_int(raw_delete, 1, row + 1);
+					raw_failures += sqlite3_step(raw_delete) != SQLITE_DONE;
+					sqlite3_reset(raw_delete);
+				}
+			});
+			exec(raw_db, "COMMIT;");
+			check(wrapper_failures == 0 && raw_failures == 0, c, "delete_from", "delete failed");
+			check_tables_match(raw_db, c, "delete_from", "SELECT count(*)", 0);
+
+			// rowids start again from 1 on the next repetition
+			exec(raw_db, "DELETE FROM bench_wrapper; DELETE FROM bench_raw;");
+		}
+
+		sqlite3_finalize(raw_insert);
+		sqlite3_finalize(raw_update);
+		sqlite3_finalize(raw_select_star);
+		sqlite3_finalize(raw_select_columns);
+		sqlite3_finalize(raw_delete);
+
+		results.insert(results.end(), { insert, update, select_star, select_columns, remove });
+	}
+
+	void write_measurement(std::ostream& os, const measurement& m) {
+		os << "{\"ns_per_op\": " << m.ns_per_op << ", \"allocations_per_op\": " << m.allocations_per_op << "}";
+	}
+
+	void write_json(std::ostream& os, const std::vector<case_result>& results) {
+		os << "{\n  \"benchmark\": \"wrapper_vs_c\",\n  \"sqlite_version\": \"" << sqlite3_libversion()
+			<< "\",\n  \"repetitions\": " << repetitions << ",\n  \"results\": [\n";
+		for (size_t i = 0; i < results.size(); ++i) {
+			const case_result& r = results[i];
+			os << "    {\"operation\": \"" << r.operation << "\", \"rows\": " << r.c.rows
+				<< ", \"columns\": " << r.c.columns << ", \"blob_bytes\": " << r.c.blob_bytes << ", \"wrapper\": ";
+			write_measurement(os, r.wrapper);
+			os << ", \"raw\": ";
+			write_measurement(os, r.raw);
+			os << ", \"overhead_ratio\": " << (r.raw.ns_per_op > 0 ? r.wrapper.ns_per_op / r.raw.ns_per_op : 0) << "}";
+			os << (i + 1 < results.size() ? ",\n" : "\n");
+		}
+		os << "  ]\n}\n";
+	}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+	// must be installed before sqlite initialises
+	sqlite3_config(SQLITE_CONFIG_GETMALLOC, &default_methods);
+	sqlite3_config(SQLITE_CONFIG_MALLOC, &counting_methods);
+
+	std::remove(database_file);
+
+	// both connections skip syncing so the comparison is of cpu work, not the disk
+	sqlite3* raw_db = nullptr;
+	if (sqlite3_open(database_file, &raw_db) != SQLITE_OK) {
+		std::cerr << "failed to open " << database_file << '\n';
+		return 1;
+	}
+	exec(raw_db, "PRAGMA journal_mode=MEMORY; PRAGMA synchronous=OFF;");
+
+	sql::open_options options;
+	options.journal_mode = sql::open_options::journal::memory;
+	options.synchronous = sql::open_options::sync::off;
+	sql::sqlite wrapper_db;
+	if (wrapper_db.open(database_file, options) != SQLITE_OK) {
+		std::cerr << "failed to open " << database_file << '\n';
+		return 1;
+	}
+
+	const std::vector<bench_case> cases{
+		{ 100, 2, 0 }, { 1000, 2, 0 }, { 10000, 2, 0 },
+		{ 1000, 8, 0 }, { 1000, 16, 0 },
+		{ 1000, 2, 1024 }, { 1000, 2, 65536 },
+	};
+
+	std::vector<case_result> results;
+	for (const bench_case& c : cases) {
+		// a new schema invalidates statements prepared against the old one
+		wrapper_db.set_statement_cache_capacity(0);
+		wrapper_db.set_statement_cache_capacity(16);
+		run_case(c, wrapper_db, raw_db, results);
+	}
+
+	wrapper_db.close();
+	sqlite3_close(raw_db);
+	std::remove(database_file);
+
+	if (argc > 1) {
+		std::ofstream out(argv[1]);
+		write_json(out, results);
+	}
+	else {
+		write_json(std::cout, results);
+	}
+	return 0;
+}
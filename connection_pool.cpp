@@ -0,0 +1,149 @@
+#include "connection_pool.hpp"
+
+namespace sql {
+
+	connection_pool::lease::lease(lease&& other) noexcept
+		: pool_(other.pool_), db_(other.db_), writer_(other.writer_) {
+		other.pool_ = nullptr;
+		other.db_ = nullptr;
+	}
+
+	connection_pool::lease& connection_pool::lease::operator=(lease&& other) noexcept {
+		if (this != &other) {
+			release();
+			pool_ = other.pool_;
+			db_ = other.db_;
+			writer_ = other.writer_;
+			other.pool_ = nullptr;
+			other.db_ = nullptr;
+		}
+		return *this;
+	}
+
+	void connection_pool::lease::release() {
+		if (pool_ && db_) {
+			pool_->give_back(db_, writer_);
+		}
+		pool_ = nullptr;
+		db_ = nullptr;
+	}
+
+	connection_pool::connection_pool() : writer_idle_(false) {}
+
+	connection_pool::~connection_pool() {
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			all_returned_.wait(lock, [this] { return all_idle(); });
+		}
+		close();
+	}
+
+	int connection_pool::open_connection(sqlite& db, const std::string& filename, int busy_timeout_ms, bool read_only) {
+		// a lease gives one thread at a time use of a connection so sqlite's own mutex is not needed
+		open_options options;
+		options.no_mutex = true;
+		options.read_only = read_only;
+		options.busy_timeout_ms = busy_timeout_ms;
+
+		int rc = db.open(filename, options);
+		if (rc != SQLITE_OK) {
+			last_error_ = db.get_last_error_description();
+		}
+		return rc;
+	}
+
+	int connection_pool::open(const std::string& filename, size_t reader_count, int busy_timeout_ms) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (writer_) { return SQLITE_MISUSE; }
+
+		auto writer = std::make_unique<sqlite>();
+		int rc = open_connection(*writer, filename, busy_timeout_ms, false);
+		if (rc != SQLITE_OK) { return rc; }
+
+		// WAL mode is persistent in the database file so setting it on the writer is enough
+		std::string mode;
+		rc = writer->pragma("journal_mode", "WAL", mode);
+		if (rc == SQLITE_OK && mode != "wal") {
+			last_error_ = "unable to set WAL journal mode, mode is " + mode;
+			rc = SQLITE_ERROR;
+		}
+		if (rc != SQLITE_OK) { return rc; }
+
+		std::vector<std::unique_ptr<sqlite>> readers;
+		for (size_t i = 0; i < reader_count; ++i) {
+			auto reader = std::make_unique<sqlite>();
+			rc = open_connection(*reader, filename, busy_timeout_ms, true);
+			if (rc != SQLITE_OK) { return rc; }
+			readers.push_back(std::move(reader));
+		}
+
+		writer_ = std::move(writer);
+		writer_idle_ = true;
+		readers_ = std::move(readers);
+		for (auto& reader : readers_) {
+			idle_readers_.push_back(reader.get());
+		}
+		return SQLITE_OK;
+	}
+
+	int connection_pool::close() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!writer_) { return SQLITE_ERROR; }
+		if (!all_idle()) { return SQLITE_BUSY; }
+
+		idle_readers_.clear();
+		readers_.clear();
+		writer_.reset();
+		writer_idle_ = false;
+		return SQLITE_OK;
+	}
+
+	int connection_pool::acquire_reader(lease& result, std::chrono::milliseconds timeout) {
+		result.release();
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (!writer_ || readers_.empty()) { return SQLITE_MISUSE; }
+
+		if (!reader_returned_.wait_for(lock, timeout, [this] { return !idle_readers_.empty(); })) {
+			return SQLITE_BUSY;
+		}
+
+		sqlite* db = idle_readers_.back();
+		idle_readers_.pop_back();
+		result = lease(this, db, false);
+		return SQLITE_OK;
+	}
+
+	int connection_pool::acquire_writer(lease& result, std::chrono::milliseconds timeout) {
+		result.release();
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (!writer_) { return SQLITE_MISUSE; }
+
+		if (!writer_returned_.wait_for(lock, timeout, [this] { return writer_idle_; })) {
+			return SQLITE_BUSY;
+		}
+
+		writer_idle_ = false;
+		result = lease(this, writer_.get(), true);
+		return SQLITE_OK;
+	}
+
+	void connection_pool::give_back(sqlite* db, bool writer) {
+		// notified under the lock, the destructor may be waiting for this last lease and
+		// destroy the condition variables as soon as the lock is free
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (writer) {
+			writer_idle_ = true;
+			writer_returned_.notify_one();
+		}
+		else {
+			idle_readers_.push_back(db);
+			reader_returned_.notify_one();
+		}
+		if (all_idle()) {
+			all_returned_.notify_all();
+		}
+	}
+
+} // sql
@@ -0,0 +1,122 @@
+/*
+sqlite - a thin c++ wrapper of sqlite c library
+version 0.0.1
+https://github.com/arcomber/sqlite_cpp
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2021 Angus Comber
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef CONNECTION_POOL_HPP_
+#define CONNECTION_POOL_HPP_
+
+#include "sqlite.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace sql {
+
+	/*
+	pool of connections to one database file for use from many threads. there is one writer
+	connection and any number of reader connections. the database is switched to WAL journal
+	mode so readers run in parallel with each other and with the writer. reader connections
+	are opened read only so a write through a reader lease fails. connections are opened
+	SQLITE_OPEN_NOMUTEX as a lease already guarantees one thread at a time.
+	connections are handed out as RAII leases, each connection used by one thread at a time.
+	*/
+	class connection_pool {
+	public:
+		/* exclusive use of one pooled connection, returned to the pool on destruction */
+		class lease {
+		public:
+			lease() : pool_(nullptr), db_(nullptr), writer_(false) {}
+			~lease() { release(); }
+
+			lease(lease&& other) noexcept;
+			lease& operator=(lease&& other) noexcept;
+			lease(const lease&) = delete;
+			lease& operator=(const lease&) = delete;
+
+			sqlite* operator->() const { return db_; }
+			sqlite& operator*() const { return *db_; }
+			explicit operator bool() const { return db_ != nullptr; }
+
+			/* give connection back to pool early */
+			void release();
+
+		private:
+			friend class connection_pool;
+			lease(connection_pool* pool, sqlite* db, bool writer) : pool_(pool), db_(db), writer_(writer) {}
+
+			connection_pool* pool_;
+			sqlite* db_;
+			bool writer_;
+		};
+
+		connection_pool();
+
+		/* waits for every lease to be returned, as a lease still out refers to the pool, then
+		closes. destroying the pool on a thread which itself holds a lease never returns */
+		~connection_pool();
+
+		connection_pool(const connection_pool&) = delete;
+		connection_pool& operator=(const connection_pool&) = delete;
+
+		/* open the writer and reader_count reader connections to filename and switch the
+		database to WAL mode. busy_timeout_ms is how long a connection waits on a lock
+		held by another connection before returning SQLITE_BUSY */
+		int open(const std::string& filename, size_t reader_count, int busy_timeout_ms = 5000);
+
+		/* close all connections. returns SQLITE_BUSY if any lease is still held */
+		int close();
+
+		/* wait up to timeout for a free reader / the writer. returns SQLITE_OK and sets
+		result, or SQLITE_BUSY if none became free in time */
+		int acquire_reader(lease& result, std::chrono::milliseconds timeout);
+		int acquire_writer(lease& result, std::chrono::milliseconds timeout);
+
+		size_t reader_count() const { return readers_.size(); }
+
+		/* error text from the last failed open */
+		const std::string& get_last_error_description() const { return last_error_; }
+
+	private:
+		std::mutex mutex_;
+		std::condition_variable reader_returned_;
+		std::condition_variable writer_returned_;
+		std::condition_variable all_returned_;
+
+		std::unique_ptr<sqlite> writer_;
+		bool writer_idle_;
+		std::vector<std::unique_ptr<sqlite>> readers_;
+		std::vector<sqlite*> idle_readers_;
+		std::string last_error_;
+
+		bool all_idle() const { return !writer_ || (writer_idle_ && idle_readers_.size() == readers_.size()); }
+		void give_back(sqlite* db, bool writer);
+		int open_connection(sqlite& db, const std::string& filename, int busy_timeout_ms, bool read_only);
+	};
+
+} // sql
+
+#endif // CONNECTION_POOL_HPP_
@@ -0,0 +1,315 @@
+/*
+sqlite - a thin c++ wrapper of sqlite c library
+version 0.0.1
+https://github.com/arcomber/sqlite_cpp
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2021 Angus Comber
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+C++20 coroutine interface over async_executor. each operation returns an awaitable which
+suspends the calling coroutine while the statement runs on an executor worker, for example:
+
+	int rc = co_await sql::co_insert_into(executor, "calls", { {"callerid", "0775512345"} });
+
+	sql::row_batch_stream rows = sql::co_select_batches(executor, "calls", {}, "", {}, 100);
+	while (co_await rows.next()) {
+		for (const auto& row : rows.batch()) { ... }
+	}
+
+by default a coroutine resumes on the worker thread which ran its statement. an event loop
+passes a resume_function which posts the handle back to the loop thread instead.
+this header is empty unless compiled as C++20 or later with coroutine support.
+*/
+
+#ifndef COROUTINE_HPP_
+#define COROUTINE_HPP_
+
+#if defined(__cpp_impl_coroutine)
+
+#include "async_executor.hpp"
+
+#include <coroutine>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sql {
+
+	/* resumes a suspended coroutine, an empty function resumes it directly */
+	using resume_function = std::function<void(std::coroutine_handle<>)>;
+
+	/* co_await runs operation on an executor worker and produces its result. if the
+	operation can not be queued the coroutine is not suspended and failure_value(rc) is produced.
+	an exception thrown by operation is rethrown from co_await */
+	template <typename result_type>
+	class query_awaitable {
+	public:
+		query_awaitable(async_executor& executor,
+			std::function<result_type(sqlite&)> operation,
+			std::function<result_type(int)> failure_value,
+			resume_function resume,
+			cancellation_token token)
+			: executor_(executor), operation_(std::move(operation)), failure_value_(std::move(failure_value)),
+			resume_(std::move(resume)), token_(std::move(token)), result_() {}
+
+		bool await_ready() const noexcept { return false; }
+
+		bool await_suspend(std::coroutine_handle<> handle) {
+			int rc = executor_.post([this, handle](sqlite* db) {
+				try {
+					result_ = db ? operation_(*db) : failure_value_(SQLITE_INTERRUPT);
+				}
+				catch (...) {
+					// the coroutine must still be resumed, or it would wait for ever
+					error_ = std::current_exception();
+				}
+				if (resume_) {
+					resume_(handle);
+				}
+				else {
+					handle.resume();
+				}
+			}, token_);
+
+			if (rc != SQLITE_OK) {
+				result_ = failure_value_(rc);
+				return false;
+			}
+			return true;
+		}
+
+		result_type await_resume() {
+			if (error_) { std::rethrow_exception(error_); }
+			return std::move(result_);
+		}
+
+	private:
+		async_executor& executor_;
+		std::function<result_type(sqlite&)> operation_;
+		std::function<result_type(int)> failure_value_;
+		resume_function resume_;
+		cancellation_token token_;
+		result_type result_;
+		std::exception_ptr error_;
+	};
+
+	inline query_awaitable<int> co_insert_into(async_executor& executor, std::string table_name,
+		std::vector<column_values> columns, resume_function resume = {}, cancellation_token token = cancellation_token()) {
+		return query_awaitable<int>(executor, [table_name = std::move(table_name), columns = std::move(columns)](sqlite& db) {
+			return db.insert_into(table_name, columns.begin(), columns.end());
+		}, [](int rc) { return rc; }, std::move(resume), std::move(token));
+	}
+
+	inline query_awaitable<int> co_update(async_executor& executor, std::string table_name,
+		std::vector<column_values> columns, std::string where_clause, std::vector<where_binding> where_bindings,
+		resume_function resume = {}, cancellation_token token = cancellation_token()) {
+		return query_awaitable<int>(executor, [table_name = std::move(table_name), columns = std::move(columns),
+			where_clause = std::move(where_clause), where_bindings = std::move(where_bindings)](sqlite& db) {
+			return db.update(table_name, columns.begin(), columns.end(), where_clause, where_bindings.begin(), where_bindings.end());
+		}, [](int rc) { return rc; }, std::move(resume), std::move(token));
+	}
+
+	inline query_awaitable<int> co_delete_from(async_executor& executor, std::string table_name,
+		std::string where_clause, std::vector<where_binding> where_bindings,
+		resume_function resume = {}, cancellation_token token = cancellation_token()) {
+		return query_awaitable<int>(executor, [table_name = std::move(table_name), where_clause = std::move(where_clause),
+			where_bindings = std::move(where_bindings)](sqlite& db) {
+			return db.delete_from(table_name, where_clause, where_bindings.begin(), where_bindings.end());
+		}, [](int rc) { return rc; }, std::move(resume), std::move(token));
+	}
+
+	/* an empty column_names selects * */
+	inline query_awaitable<select_result> co_select_columns(async_executor& executor, std::string table_name,
+		std::vector<std::string> column_names, std::string where_clause, std::vector<where_binding> where_bindings,
+		resume_function resume = {}, cancellation_token token = cancellation_token()) {
+		return query_awaitable<select_result>(executor, [table_name = std::move(table_name), column_names = std::move(column_names),
+			where_clause = std::move(where_clause), where_bindings = std::move(where_bindings)](sqlite& db) {
+			select_result result;
+			result.rc = db.select_columns(table_name, column_names.begin(), column_names.end(),
+				where_clause, where_bindings.begin(), where_bindings.end(), result.rows);
+			return result;
+		}, [](int rc) { select_result result; result.rc = rc; return result; }, std::move(resume), std::move(token));
+	}
+
+	/*
+	asynchronous generator of row batches from one SELECT. the statement runs on a single
+	executor worker through a cursor, so every batch comes from the same read and memory stays
+	at one batch. the worker is held until the rows run out or the stream is destroyed.
+	co_await next() produces true with batch() filled, or false when finished, when status()
+	is SQLITE_DONE or the error code.
+	*/
+	class row_batch_stream {
+	public:
+		using row_type = cursor::row_type;
+
+		row_batch_stream(row_batch_stream&&) noexcept = default;
+		row_batch_stream& operator=(row_batch_stream&&) = delete;
+		row_batch_stream(const row_batch_stream&) = delete;
+		row_batch_stream& operator=(const row_batch_stream&) = delete;
+
+		~row_batch_stream() {
+			if (!state_) { return; }
+			{
+				std::lock_guard<std::mutex> lock(state_->mutex);
+				state_->abandoned = true;
+			}
+			state_->wanted.notify_one();
+		}
+
+		class next_awaitable {
+		public:
+			explicit next_awaitable(row_batch_stream& stream) : stream_(stream) {}
+
+			bool await_ready() const noexcept { return false; }
+
+			bool await_suspend(std::coroutine_handle<> handle) {
+				std::lock_guard<std::mutex> lock(stream_.state_->mutex);
+				stream_.batch_.clear();
+				if (stream_.state_->finished) { return false; }
+
+				stream_.state_->waiter = handle;
+				stream_.state_->want_batch = true;
+				stream_.state_->wanted.notify_one();
+				return true;
+			}
+
+			bool await_resume() {
+				std::lock_guard<std::mutex> lock(stream_.state_->mutex);
+				stream_.batch_.swap(stream_.state_->batch);
+				return !stream_.batch_.empty();
+			}
+
+		private:
+			row_batch_stream& stream_;
+		};
+
+		next_awaitable next() { return next_awaitable(*this); }
+
+		const std::vector<row_type>& batch() const { return batch_; }
+
+		/* SQLITE_OK while rows may remain, then SQLITE_DONE or the error code */
+		int status() const {
+			std::lock_guard<std::mutex> lock(state_->mutex);
+			return state_->status;
+		}
+
+	private:
+		friend row_batch_stream co_select_batches(async_executor&, std::string, std::vector<std::string>,
+			std::string, std::vector<where_binding>, size_t, resume_function, cancellation_token);
+
+		struct shared_state {
+			std::mutex mutex;
+			std::condition_variable wanted;
+			std::vector<row_type> batch;
+			int status = SQLITE_OK;
+			bool want_batch = false;
+			bool finished = false;
+			bool abandoned = false;
+			std::coroutine_handle<> waiter;
+			resume_function resume;
+		};
+
+		row_batch_stream() : state_(std::make_shared<shared_state>()) {}
+
+		std::shared_ptr<shared_state> state_;
+		std::vector<row_type> batch_;
+
+		static void produce(const std::shared_ptr<shared_state>& state, sqlite* db, const std::string& table_name,
+			const std::vector<std::string>& column_names, const std::string& where_clause,
+			const std::vector<where_binding>& where_bindings, size_t batch_size) {
+			cursor rows;
+			int rc = db ? db->select_cursor(table_name, column_names.begin(), column_names.end(),
+				where_clause, where_bindings.begin(), where_bindings.end(), rows) : SQLITE_INTERRUPT;
+
+			for (;;) {
+				std::unique_lock<std::mutex> lock(state->mutex);
+				state->wanted.wait(lock, [&state] { return state->want_batch || state->abandoned; });
+				if (state->abandoned) { return; }
+
+				// step outside the lock so status() and the destructor never wait on sqlite
+				lock.unlock();
+				std::vector<row_type> batch;
+				while (rc == SQLITE_OK && batch.size() < batch_size) {
+					int step = rows.next();
+					if (step == SQLITE_ROW) {
+						batch.push_back(rows.row());
+					}
+					else {
+						rc = step;
+					}
+				}
+				if (rc != SQLITE_OK) {
+					rows.close();
+				}
+				lock.lock();
+
+				state->batch = std::move(batch);
+				state->want_batch = false;
+				if (rc != SQLITE_OK) {
+					state->status = rc;
+					state->finished = true;
+				}
+				std::coroutine_handle<> waiter = std::exchange(state->waiter, nullptr);
+				bool finished = state->finished;
+				// the consumer may have gone while the batch was read, its coroutine no longer exists
+				if (state->abandoned || !waiter) { return; }
+				lock.unlock();
+
+				if (state->resume) {
+					state->resume(waiter);
+				}
+				else {
+					waiter.resume();
+				}
+				if (finished) { return; }
+			}
+		}
+	};
+
+	/* start an asynchronous SELECT producing rows in batches of batch_size.
+	an empty column_names selects * */
+	inline row_batch_stream co_select_batches(async_executor& executor, std::string table_name,
+		std::vector<std::string> column_names, std::string where_clause, std::vector<where_binding> where_bindings,
+		size_t batch_size, resume_function resume = {}, cancellation_token token = cancellation_token()) {
+		row_batch_stream stream;
+		stream.state_->resume = std::move(resume);
+
+		int rc = executor.post([state = stream.state_, table_name = std::move(table_name), column_names = std::move(column_names),
+			where_clause = std::move(where_clause), where_bindings = std::move(where_bindings), batch_size](sqlite* db) {
+			row_batch_stream::produce(state, db, table_name, column_names, where_clause, where_bindings, batch_size == 0 ? 1 : batch_size);
+		}, std::move(token));
+
+		if (rc != SQLITE_OK) {
+			stream.state_->status = rc;
+			stream.state_->finished = true;
+		}
+		return stream;
+	}
+
+} // sql
+
+#endif // __cpp_impl_coroutine
+
+#endif // COROUTINE_HPP_
@@ -0,0 +1,160 @@
+#include "group_commit.hpp"
+
+#include <algorithm>
+
+namespace sql {
+
+	group_commit_writer::group_commit_writer()
+		: head_(nullptr), queued_(0), producers_(0), accepting_(false), stopping_(false),
+		writer_sleeping_(false), max_batch_rows_(1), max_wait_(0), batches_committed_(0) {}
+
+	group_commit_writer::~group_commit_writer() {
+		close();
+	}
+
+	int group_commit_writer::open(const std::string& filename, size_t max_batch_rows, unsigned max_wait_us,
+		const open_options& options) {
+		if (accepting_ || writer_.joinable()) { return SQLITE_MISUSE; }
+
+		int rc = db_.open(filename, options);
+		if (rc != SQLITE_OK) {
+			last_error_ = db_.get_last_error_description();
+			db_.close();
+			return rc;
+		}
+
+		max_batch_rows_ = std::max<size_t>(max_batch_rows, 1);
+		max_wait_ = std::chrono::microseconds(max_wait_us);
+		stopping_ = false;
+		accepting_ = true;
+		writer_ = std::thread(&group_commit_writer::writer_loop, this);
+		return SQLITE_OK;
+	}
+
+	void group_commit_writer::close() {
+		if (!writer_.joinable()) { return; }
+
+		// wait out producers which saw accepting_ before it was cleared so no row is left behind
+		accepting_ = false;
+		{
+			std::unique_lock<std::mutex> lock(sleep_mutex_);
+			producers_idle_.wait(lock, [this] { return producers_ == 0; });
+			stopping_ = true;
+		}
+		wake_.notify_one();
+		writer_.join();
+		db_.close();
+	}
+
+	std::future<int> group_commit_writer::insert_into(std::string table_name, std::vector<column_values> columns) {
+		auto row = new pending_row{ std::move(table_name), std::move(columns), std::promise<int>() };
+		std::future<int> result = row->done.get_future();
+
+		++producers_;
+		if (!accepting_) {
+			leave_producers();
+			row->done.set_value(SQLITE_MISUSE);
+			delete row;
+			return result;
+		}
+
+		// counted before it is pushed so queued_ never falls below the rows on the stack
+		size_t queued = ++queued_;
+		row->next = head_.load(std::memory_order_relaxed);
+		while (!head_.compare_exchange_weak(row->next, row, std::memory_order_release, std::memory_order_relaxed)) {}
+		leave_producers();
+
+		// the writer only needs waking when idle or when this row completes a batch
+		if (writer_sleeping_ && (queued == 1 || queued >= max_batch_rows_)) {
+			std::lock_guard<std::mutex> lock(sleep_mutex_);
+			wake_.notify_one();
+		}
+		return result;
+	}
+
+	void group_commit_writer::leave_producers() {
+		// close clears accepting_ before it waits, so the last producer out after that wakes it
+		if (--producers_ == 0 && !accepting_) {
+			std::lock_guard<std::mutex> lock(sleep_mutex_);
+			producers_idle_.notify_all();
+		}
+	}
+
+	void group_commit_writer::take_queued(std::vector<pending_row*>& batch) {
+		pending_row* taken = head_.exchange(nullptr, std::memory_order_acquire);
+		for (; taken; taken = taken->next) {
+			batch.push_back(taken);
+		}
+		queued_ -= batch.size();
+		std::reverse(batch.begin(), batch.end());
+	}
+
+	template <typename predicate>
+	void group_commit_writer::sleep_until(const std::chrono::steady_clock::time_point* deadline, predicate ready) {
+		std::unique_lock<std::mutex> lock(sleep_mutex_);
+		writer_sleeping_ = true;
+		auto woken = [this, &ready] { return stopping_ || ready(); };
+		if (deadline) {
+			wake_.wait_until(lock, *deadline, woken);
+		}
+		else {
+			wake_.wait(lock, woken);
+		}
+		writer_sleeping_ = false;
+	}
+
+	void group_commit_writer::writer_loop() {
+		std::vector<pending_row*> batch;
+		for (;;) {
+			sleep_until(nullptr, [this] { return queued_ != 0; });
+
+			// give other producers up to max_wait_ from the first row to join this commit
+			if (!stopping_) {
+				const auto deadline = std::chrono::steady_clock::now() + max_wait_;
+				sleep_until(&deadline, [this] { return queued_ >= max_batch_rows_; });
+			}
+
+			take_queued(batch);
+			if (batch.empty()) {
+				if (stopping_) { return; }
+				continue;
+			}
+
+			commit_batch(batch);
+			batch.clear();
+		}
+	}
+
+	void group_commit_writer::commit_batch(std::vector<pending_row*>& batch) {
+		if (batch.empty()) { return; }
+
+		std::vector<int> results(batch.size(), SQLITE_OK);
+		transaction txn(db_);
+		int rc = txn.begin(transaction::mode::immediate);
+		if (rc == SQLITE_OK) {
+			for (size_t i = 0; i < batch.size(); ++i) {
+				results[i] = db_.insert_into(batch[i]->table_name, batch[i]->columns.begin(), batch[i]->columns.end());
+
+				// after eg SQLITE_FULL, IOERR or NOMEM sqlite may have rolled back the whole
+				// transaction, the rows before this one are gone and the rest would autocommit
+				if (results[i] != SQLITE_OK && sqlite3_get_autocommit(db_.db_) != 0) {
+					rc = results[i];
+					txn.rollback();
+					break;
+				}
+			}
+			if (rc == SQLITE_OK) {
+				rc = txn.commit();
+			}
+		}
+		if (rc == SQLITE_OK) {
+			++batches_committed_;
+		}
+
+		for (size_t i = 0; i < batch.size(); ++i) {
+			batch[i]->done.set_value(rc == SQLITE_OK ? results[i] : rc);
+			delete batch[i];
+		}
+	}
+
+} // sql
@@ -0,0 +1,118 @@
+/*
+sqlite - a thin c++ wrapper of sqlite c library
+version 0.0.1
+https://github.com/arcomber/sqlite_cpp
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2021 Angus Comber
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef GROUP_COMMIT_HPP_
+#define GROUP_COMMIT_HPP_
+
+#include "sqlite.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sql {
+
+	/*
+	merges inserts from many threads into shared transactions so they share one commit, and
+	with synchronous=FULL one fsync, instead of paying for one each. producers push rows onto a
+	lock-free queue and get a future back. a single writer thread drains the queue into a
+	transaction once max_batch_rows are waiting or max_wait_us has passed since the first of
+	them arrived. every future in a batch is completed after the COMMIT, so SQLITE_OK means the
+	row is durable to the level of the connection's synchronous setting.
+	a row which fails (eg a constraint) gets its own error code and does not fail the batch.
+	if BEGIN or COMMIT fails, or a failed row makes sqlite roll back the whole transaction,
+	every row of the batch gets that error code.
+	*/
+	class group_commit_writer {
+	public:
+		group_commit_writer();
+		~group_commit_writer();
+
+		group_commit_writer(const group_commit_writer&) = delete;
+		group_commit_writer& operator=(const group_commit_writer&) = delete;
+
+		/* open the writer connection to filename and start the writer thread */
+		int open(const std::string& filename, size_t max_batch_rows, unsigned max_wait_us,
+			const open_options& options = open_options::durable());
+
+		/* stop accepting rows, commit those already queued and close the connection */
+		void close();
+
+		/* queue INSERT INTO table_name. the future is ready with SQLITE_MISUSE at once if not open */
+		std::future<int> insert_into(std::string table_name, std::vector<column_values> columns);
+
+		/* number of transactions committed, for measuring the batching achieved */
+		uint64_t batches_committed() const { return batches_committed_.load(std::memory_order_relaxed); }
+
+		/* error text from the last failed open */
+		const std::string& get_last_error_description() const { return last_error_; }
+
+	private:
+		struct pending_row {
+			std::string table_name;
+			std::vector<column_values> columns;
+			std::promise<int> done;
+			pending_row* next = nullptr;
+		};
+
+		// intrusive multi-producer single-consumer stack, taken whole and reversed by the writer
+		std::atomic<pending_row*> head_;
+		std::atomic<size_t> queued_;
+		std::atomic<size_t> producers_;
+		std::atomic<bool> accepting_;
+		std::atomic<bool> stopping_;
+
+		// only used to park the writer when idle and close while producers finish. producers
+		// lock it only if the writer sleeps or close is waiting
+		std::mutex sleep_mutex_;
+		std::condition_variable wake_;
+		std::condition_variable producers_idle_;
+		std::atomic<bool> writer_sleeping_;
+
+		size_t max_batch_rows_;
+		std::chrono::microseconds max_wait_;
+		sqlite db_;
+		std::thread writer_;
+		std::string last_error_;
+		std::atomic<uint64_t> batches_committed_;
+
+		void writer_loop();
+		/* decrement producers_, waking close when the last one leaves */
+		void leave_producers();
+		/* move all queued rows into an empty batch in arrival order */
+		void take_queued(std::vector<pending_row*>& batch);
+		/* park the writer until stopping or ready(), or deadline if not nullptr */
+		template <typename predicate>
+		void sleep_until(const std::chrono::steady_clock::time_point* deadline, predicate ready);
+		void commit_batch(std::vector<pending_row*>& batch);
+	};
+
+} // sql
+
+#endif // GROUP_COMMIT_HPP_
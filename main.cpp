@@ -5,6 +5,7 @@
 	CREATE TABLE test (name TEXT, age INTEGER, photo BLOB);
 */
 #include "sqlite.hpp"
+#include "mapped_file.hpp"
 
 #include <iostream>
 #include <string>
@@ -23,19 +24,18 @@ int main()
 	std::cout << "db.open returned: " << rc << std::endl;
 
 	// picture from https://en.wikipedia.org/wiki/Mickey_Mouse
-	std::ifstream f("Mickey_Mouse.png", std::ios::binary);
+	// the file is memory mapped and bound in place, so it is never copied into a buffer
+	sql::mapped_file photo;
 
-	if (!f.good()) {
+	if (photo.open("Mickey_Mouse.png") != SQLITE_OK) {
 		std::cout << "failed to open Mickey Mouse bitmap file\n";
 		return 1;
 	}
 
-	std::vector<uint8_t> buffer(std::istreambuf_iterator<char>(f), {});
-
 	std::vector<sql::column_values> params {
 		{"name", "Mickey Mouse"},
 		{"age", 12},
-		{"photo", buffer}
+		{"photo", photo.view()}
 	};
 
 	for (const auto& param : params) {
@@ -45,13 +45,16 @@ int main()
 	rc = db.insert_into("test", params.begin(), params.end());
 	std::cout << "db.insert_into(...) returned: " << rc << std::endl;
 
-	int lastrowid = 0;
+	int64_t lastrowid = 0;
 
 	if (rc == SQLITE_OK) {
 		lastrowid = db.last_insert_rowid();
 		std::cout << "inserted into rowid: " << lastrowid << std::endl;
 	}
 
+	// a larger file could instead be streamed in with blob_stream::write_from after inserting
+	// a sql::zeroblob{ size } placeholder
+
 	// let us now update this record
 	std::vector<sql::column_values> updated_params{
 	{"name", "Donald Duck"},
@@ -0,0 +1,106 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <utility>
+
+namespace sql {
+
+	mapped_file::mapped_file(mapped_file&& other) noexcept
+		: address_(std::exchange(other.address_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+
+	mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+		if (this != &other) {
+			close();
+			address_ = std::exchange(other.address_, nullptr);
+			size_ = std::exchange(other.size_, 0);
+		}
+		return *this;
+	}
+
+#ifdef _WIN32
+	int mapped_file::open(const std::string& filename) {
+		close();
+
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) { return SQLITE_CANTOPEN; }
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size)) {
+			CloseHandle(file);
+			return SQLITE_CANTOPEN;
+		}
+		if (file_size.QuadPart == 0) {
+			CloseHandle(file);
+			return SQLITE_OK;
+		}
+
+		// the view keeps the mapping and file open once the handles are closed
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(file);
+		if (mapping == NULL) { return SQLITE_CANTOPEN; }
+
+		address_ = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (address_ == NULL) { return SQLITE_CANTOPEN; }
+
+		size_ = static_cast<size_t>(file_size.QuadPart);
+		return SQLITE_OK;
+	}
+
+	void mapped_file::close() {
+		if (address_) {
+			UnmapViewOfFile(address_);
+		}
+		address_ = nullptr;
+		size_ = 0;
+	}
+#else
+	int mapped_file::open(const std::string& filename) {
+		close();
+
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0) { return SQLITE_CANTOPEN; }
+
+		struct stat file_stat;
+		if (fstat(fd, &file_stat) != 0) {
+			::close(fd);
+			return SQLITE_CANTOPEN;
+		}
+		if (file_stat.st_size == 0) {
+			::close(fd);
+			return SQLITE_OK;
+		}
+
+		// the mapping keeps the file open once fd is closed
+		void* address = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (address == MAP_FAILED) { return SQLITE_CANTOPEN; }
+
+		// sqlite copies the bytes front to back
+		madvise(address, static_cast<size_t>(file_stat.st_size), MADV_SEQUENTIAL);
+
+		address_ = address;
+		size_ = static_cast<size_t>(file_stat.st_size);
+		return SQLITE_OK;
+	}
+
+	void mapped_file::close() {
+		if (address_) {
+			munmap(address_, size_);
+		}
+		address_ = nullptr;
+		size_ = 0;
+	}
+#endif
+
+} // sql
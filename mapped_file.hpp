@@ -0,0 +1,73 @@
+/*
+sqlite - a thin c++ wrapper of sqlite c library
+version 0.0.1
+https://github.com/arcomber/sqlite_cpp
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2021 Angus Comber
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MAPPED_FILE_HPP_
+#define MAPPED_FILE_HPP_
+
+#include "sqlite.hpp"
+
+#include <string>
+
+namespace sql {
+
+	/*
+	read only memory map of a whole file, for binding a file's content as a BLOB without
+	reading it into a buffer first:
+
+		sql::mapped_file photo;
+		if (photo.open("Mickey_Mouse.png") == SQLITE_OK) {
+			std::vector<sql::column_values> params{ {"name", "Mickey Mouse"}, {"photo", photo.view()} };
+			db.insert_into("test", params.begin(), params.end());
+		}
+
+	the view is bound SQLITE_STATIC so the file must stay mapped until the statement returns.
+	pages are read from the file as sqlite copies them into the database.
+	*/
+	class mapped_file {
+	public:
+		mapped_file() : address_(nullptr), size_(0) {}
+		~mapped_file() { close(); }
+
+		mapped_file(mapped_file&& other) noexcept;
+		mapped_file& operator=(mapped_file&& other) noexcept;
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		/* map filename. returns SQLITE_OK, or SQLITE_CANTOPEN if it can not be opened or
+		mapped. an empty file maps to an empty view */
+		int open(const std::string& filename);
+
+		void close();
+
+		blob_view view() const { return blob_view{ static_cast<const uint8_t*>(address_), size_ }; }
+		size_t size() const { return size_; }
+
+	private:
+		void* address_;
+		size_t size_;
+	};
+
+} // sql
+
+#endif // MAPPED_FILE_HPP_
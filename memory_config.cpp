@@ -0,0 +1,239 @@
+#include "memory_config.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+namespace sql {
+
+	namespace {
+
+		/*
+		size class pool. each block is preceded by a 16 byte header holding its usable size and
+		class, so blocks stay 16 byte aligned and xSize needs no lookup. freed blocks of a class
+		go onto the freeing thread's cache and move in batches between it and a shared list
+		when it runs empty or grows past thread_cache_limit. larger requests go straight to malloc.
+		blocks are never returned to malloc, the pool keeps the high water mark of each class
+		*/
+		constexpr int class_sizes[] = { 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+		constexpr int class_count = sizeof(class_sizes) / sizeof(class_sizes[0]);
+		constexpr size_t thread_cache_limit = 256;
+		constexpr size_t transfer_batch = 64;
+
+		struct alignas(16) block_header {
+			int64_t size;        // usable bytes
+			int64_t size_class;  // index into class_sizes, -1 if allocated by malloc
+		};
+
+		struct free_block {
+			free_block* next;
+		};
+
+		struct free_list {
+			free_block* head = nullptr;
+			size_t count = 0;
+
+			void push(free_block* block) {
+				block->next = head;
+				head = block;
+				++count;
+			}
+
+			free_block* pop() {
+				free_block* block = head;
+				if (block) {
+					head = block->next;
+					--count;
+				}
+				return block;
+			}
+		};
+
+		struct shared_list {
+			std::mutex mutex;
+			free_list blocks;
+		};
+
+		shared_list shared_lists[class_count];
+		// only the slow paths are counted, a shared counter on every call would be contended
+		std::atomic<uint64_t> malloc_calls(0);
+		std::atomic<uint64_t> shared_list_transfers(0);
+
+		// move up to count blocks from one list to another
+		void transfer(free_list& from, free_list& to, size_t count) {
+			for (size_t i = 0; i < count; ++i) {
+				free_block* block = from.pop();
+				if (!block) { break; }
+				to.push(block);
+			}
+		}
+
+		struct thread_cache {
+			free_list lists[class_count];
+
+			~thread_cache();
+		};
+
+		// trivially destructible so still readable while a thread's destructors run
+		thread_local bool thread_cache_destroyed = false;
+		thread_local thread_cache cache;
+
+		thread_cache::~thread_cache() {
+			thread_cache_destroyed = true;
+			for (int i = 0; i < class_count; ++i) {
+				std::lock_guard<std::mutex> lock(shared_lists[i].mutex);
+				transfer(lists[i], shared_lists[i].blocks, lists[i].count);
+			}
+		}
+
+		int size_class(int size) {
+			for (int i = 0; i < class_count; ++i) {
+				if (size <= class_sizes[i]) { return i; }
+			}
+			return -1;
+		}
+
+		block_header* header_of(void* p) {
+			return static_cast<block_header*>(p) - 1;
+		}
+
+		void* new_block(int64_t size, int64_t size_class) {
+			malloc_calls.fetch_add(1, std::memory_order_relaxed);
+			block_header* header = static_cast<block_header*>(std::malloc(sizeof(block_header) + static_cast<size_t>(size)));
+			if (!header) { return nullptr; }
+			header->size = size;
+			header->size_class = size_class;
+			return header + 1;
+		}
+
+		void* pool_malloc(int size) {
+			if (size <= 0) { return nullptr; }
+
+			const int cls = size_class(size);
+			if (cls < 0) { return new_block(size, -1); }
+
+			if (!thread_cache_destroyed) {
+				free_list& list = cache.lists[cls];
+				if (list.count == 0) {
+					shared_list_transfers.fetch_add(1, std::memory_order_relaxed);
+					std::lock_guard<std::mutex> lock(shared_lists[cls].mutex);
+					transfer(shared_lists[cls].blocks, list, transfer_batch);
+				}
+				if (free_block* block = list.pop()) { return block; }
+			}
+			else {
+				std::lock_guard<std::mutex> lock(shared_lists[cls].mutex);
+				if (free_block* block = shared_lists[cls].blocks.pop()) { return block; }
+			}
+			return new_block(class_sizes[cls], cls);
+		}
+
+		void pool_free(void* p) {
+			if (!p) { return; }
+
+			block_header* header = header_of(p);
+			const int64_t cls = header->size_class;
+			if (cls < 0) {
+				std::free(header);
+				return;
+			}
+
+			free_block* block = static_cast<free_block*>(p);
+			if (thread_cache_destroyed) {
+				std::lock_guard<std::mutex> lock(shared_lists[cls].mutex);
+				shared_lists[cls].blocks.push(block);
+				return;
+			}
+
+			free_list& list = cache.lists[cls];
+			list.push(block);
+			if (list.count > thread_cache_limit) {
+				shared_list_transfers.fetch_add(1, std::memory_order_relaxed);
+				std::lock_guard<std::mutex> lock(shared_lists[cls].mutex);
+				transfer(list, shared_lists[cls].blocks, transfer_batch);
+			}
+		}
+
+		int pool_size(void* p) {
+			return p ? static_cast<int>(header_of(p)->size) : 0;
+		}
+
+		void* pool_realloc(void* p, int size) {
+			if (!p) { return pool_malloc(size); }
+
+			// a block already big enough is kept, so growing within a class is free
+			const int current = pool_size(p);
+			if (size <= current && header_of(p)->size_class >= 0) { return p; }
+
+			void* resized = pool_malloc(size);
+			if (resized) {
+				std::memcpy(resized, p, static_cast<size_t>(current < size ? current : size));
+				pool_free(p);
+			}
+			return resized;
+		}
+
+		int pool_roundup(int size) {
+			const int cls = size_class(size);
+			return cls < 0 ? (size + 7) & ~7 : class_sizes[cls];
+		}
+
+		int pool_init(void*) { return SQLITE_OK; }
+		void pool_shutdown(void*) {}
+
+		sqlite3_mem_methods pool_methods = {
+			pool_malloc, pool_free, pool_realloc, pool_size, pool_roundup, pool_init, pool_shutdown, nullptr
+		};
+
+		// allocator in use before the pool was installed
+		bool pool_installed = false;
+		sqlite3_mem_methods previous_methods;
+
+		// install the pool or put back the allocator it replaced
+		int set_pool_allocator(bool enabled) {
+			if (enabled && !pool_installed) {
+				int rc = sqlite3_config(SQLITE_CONFIG_GETMALLOC, &previous_methods);
+				if (rc == SQLITE_OK) {
+					rc = sqlite3_config(SQLITE_CONFIG_MALLOC, &pool_methods);
+				}
+				if (rc != SQLITE_OK) { return rc; }
+				pool_installed = true;
+			}
+			else if (!enabled && pool_installed) {
+				int rc = sqlite3_config(SQLITE_CONFIG_MALLOC, &previous_methods);
+				if (rc != SQLITE_OK) { return rc; }
+				pool_installed = false;
+			}
+			return SQLITE_OK;
+		}
+
+	} // anonymous namespace
+
+	int configure_memory(const memory_options& options) {
+		const bool was_installed = pool_installed;
+		int rc = set_pool_allocator(options.pool_allocator);
+		if (rc != SQLITE_OK) { return rc; }
+
+		if (options.memory_status) {
+			rc = sqlite3_config(SQLITE_CONFIG_MEMSTATUS, *options.memory_status ? 1 : 0);
+		}
+		if (rc == SQLITE_OK && options.lookaside_slot_size && options.lookaside_slot_count) {
+			rc = sqlite3_config(SQLITE_CONFIG_LOOKASIDE, *options.lookaside_slot_size, *options.lookaside_slot_count);
+		}
+
+		// a failed call leaves the allocator as it was rather than half configured
+		if (rc != SQLITE_OK) {
+			set_pool_allocator(was_installed);
+		}
+		return rc;
+	}
+
+	pool_statistics get_pool_statistics() {
+		pool_statistics statistics;
+		statistics.malloc_calls = malloc_calls.load(std::memory_order_relaxed);
+		statistics.shared_list_transfers = shared_list_transfers.load(std::memory_order_relaxed);
+		return statistics;
+	}
+
+} // sql
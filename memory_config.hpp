@@ -0,0 +1,71 @@
+/*
+sqlite - a thin c++ wrapper of sqlite c library
+version 0.0.1
+https://github.com/arcomber/sqlite_cpp
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2021 Angus Comber
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MEMORY_CONFIG_HPP_
+#define MEMORY_CONFIG_HPP_
+
+#include "sqlite3.h"
+
+#include <cstdint>
+#include <optional>
+
+namespace sql {
+
+	/* process wide sqlite memory settings, see https://sqlite.org/malloc.html.
+	settings left empty keep the sqlite default */
+	struct memory_options {
+		// route sqlite's allocations through a size class pool with per thread caches, so
+		// the many small allocations of prepare, step and row decoding rarely reach malloc
+		bool pool_allocator = false;
+
+		// SQLITE_CONFIG_MEMSTATUS, false stops sqlite keeping global memory statistics under
+		// a mutex on every allocation. sqlite3_memory_used then reports nothing useful
+		std::optional<bool> memory_status;
+
+		// SQLITE_CONFIG_LOOKASIDE, default lookaside for every new connection. both must be set.
+		// open_options::lookaside_slot_size / count override it for one connection
+		std::optional<int> lookaside_slot_size;
+		std::optional<int> lookaside_slot_count;
+	};
+
+	/* apply options to the sqlite library. sqlite only accepts this before it is initialised,
+	ie before the first connection is opened, or after sqlite3_shutdown, otherwise SQLITE_MISUSE
+	is returned. pool_allocator false puts back the allocator in use before the pool was installed.
+	if a later setting fails the allocator is put back as it was before the call. memory_status
+	has no getter in sqlite, so one already applied stays. not thread safe, call it during start up */
+	int configure_memory(const memory_options& options);
+
+	/* slow path counters of the pool allocator. calls served from a thread cache are not
+	counted, so a low number of either relative to the work done means the caches are effective */
+	struct pool_statistics {
+		uint64_t malloc_calls = 0;           // blocks allocated from malloc
+		uint64_t shared_list_transfers = 0;  // batches moved between a thread cache and the shared lists
+	};
+
+	/* counters of the pool allocator since it was installed, zero if it never was */
+	pool_statistics get_pool_statistics();
+
+} // sql
+
+#endif // MEMORY_CONFIG_HPP_
@@ -0,0 +1,343 @@
+#include "page_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace sql {
+
+	namespace {
+
+		struct cache_instance;
+
+		// allocated in one block with the page buffer and extra bytes following it
+		struct page {
+			sqlite3_pcache_page base;
+			cache_instance* owner;
+			unsigned key;
+			bool pinned;
+			bool referenced;
+			size_t clock_index;   // position in its shard's clock ring
+		};
+
+		struct cache_instance {
+			uint64_t id;
+			int page_size;
+			int extra_size;
+			bool purgeable;       // false for in-memory databases, whose pages must never be evicted
+			std::atomic<int> max_pages;
+			std::atomic<unsigned> page_count;
+			std::atomic<size_t> evict_shard;   // shard to look in first for a page of its own to reuse
+		};
+
+		struct shard {
+			std::mutex mutex;
+			std::unordered_map<uint64_t, page*> pages;
+			std::vector<page*> clock;
+			size_t hand = 0;
+			size_t max_pages = 0;   // share of page_cache_options::max_pages, 0 unlimited
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t evictions = 0;
+		};
+
+		std::vector<std::unique_ptr<shard>> shards;
+		std::atomic<uint64_t> next_cache_id(1);
+
+		uint64_t page_id(const cache_instance* cache, unsigned key) {
+			return (cache->id << 32) | key;
+		}
+
+		shard& shard_of(const cache_instance* cache, unsigned key) {
+			// mix so consecutive pages of one database spread over the shards
+			uint64_t h = page_id(cache, key) * 0x9E3779B97F4A7C15ull;
+			return *shards[(h >> 32) % shards.size()];
+		}
+
+		void add_page(shard& s, page* p) {
+			s.pages.emplace(page_id(p->owner, p->key), p);
+			p->clock_index = s.clock.size();
+			s.clock.push_back(p);
+			++p->owner->page_count;
+		}
+
+		// take p out of s without freeing it
+		void remove_page(shard& s, page* p) {
+			s.pages.erase(page_id(p->owner, p->key));
+			page* last = s.clock.back();
+			s.clock[p->clock_index] = last;
+			last->clock_index = p->clock_index;
+			s.clock.pop_back();
+			if (s.hand >= s.clock.size()) {
+				s.hand = 0;
+			}
+			--p->owner->page_count;
+		}
+
+		void free_page(shard& s, page* p) {
+			remove_page(s, p);
+			sqlite3_free(p);
+		}
+
+		// CLOCK: sweep at most twice round the ring for an unpinned, purgeable page not
+		// referenced since the last sweep, clearing reference bits on the way. owner, if
+		// not null, limits the sweep to the pages of one cache and leaves the others untouched
+		page* evict_one(shard& s, const cache_instance* owner = nullptr) {
+			for (size_t steps = 0; steps < 2 * s.clock.size(); ++steps) {
+				if (s.hand >= s.clock.size()) {
+					s.hand = 0;
+				}
+				page* p = s.clock[s.hand++];
+				if (owner && p->owner != owner) { continue; }
+				if (p->pinned || !p->owner->purgeable) { continue; }
+				if (p->referenced) {
+					p->referenced = false;
+					continue;
+				}
+				remove_page(s, p);
+				++s.evictions;
+				return p;
+			}
+			return nullptr;
+		}
+
+		// a page of cache to reuse when it reaches its own cache_size. its pages are spread
+		// over every shard so they are searched in turn. the caller must hold no shard lock
+		page* evict_own(cache_instance* cache) {
+			const size_t first = cache->evict_shard.load(std::memory_order_relaxed);
+			for (size_t i = 0; i < shards.size(); ++i) {
+				const size_t index = (first + i) % shards.size();
+				shard& s = *shards[index];
+				std::lock_guard<std::mutex> lock(s.mutex);
+				if (page* p = evict_one(s, cache)) {
+					// start the next search where this one ended, like a clock hand over the shards
+					cache->evict_shard.store(index + 1, std::memory_order_relaxed);
+					return p;
+				}
+			}
+			return nullptr;
+		}
+
+		int page_cache_init(void*) { return SQLITE_OK; }
+		void page_cache_shutdown(void*) {}
+
+		sqlite3_pcache* page_cache_create(int page_size, int extra_size, int purgeable) {
+			cache_instance* cache = new (std::nothrow) cache_instance;
+			if (!cache) { return nullptr; }
+			cache->id = next_cache_id++;
+			cache->page_size = page_size;
+			cache->extra_size = extra_size;
+			cache->purgeable = purgeable != 0;
+			cache->max_pages = 0;
+			cache->page_count = 0;
+			cache->evict_shard = 0;
+			return reinterpret_cast<sqlite3_pcache*>(cache);
+		}
+
+		cache_instance* instance(sqlite3_pcache* cache) {
+			return reinterpret_cast<cache_instance*>(cache);
+		}
+
+		void page_cache_cachesize(sqlite3_pcache* cache, int max_pages) {
+			instance(cache)->max_pages = max_pages;
+		}
+
+		int page_cache_pagecount(sqlite3_pcache* cache) {
+			return static_cast<int>(instance(cache)->page_count.load());
+		}
+
+		sqlite3_pcache_page* page_cache_fetch(sqlite3_pcache* pcache, unsigned key, int create_flag) {
+			cache_instance* cache = instance(pcache);
+			shard& s = shard_of(cache, key);
+			std::unique_lock<std::mutex> lock(s.mutex);
+
+			auto found = s.pages.find(page_id(cache, key));
+			if (found != s.pages.end()) {
+				++s.hits;
+				found->second->pinned = true;
+				found->second->referenced = true;
+				return &found->second->base;
+			}
+			++s.misses;
+			if (create_flag == 0) { return nullptr; }
+
+			// 1 asks for a page only if it is cheap to get, 2 asks for every effort
+			page* p = nullptr;
+			bool full = false;
+			if (cache->purgeable && cache->max_pages > 0 && cache->page_count >= static_cast<unsigned>(cache->max_pages)) {
+				// the connection's own cache_size only ever reuses its own pages. sqlite calls a
+				// cache from one connection at a time, so no one else can add key meanwhile
+				full = true;
+				lock.unlock();
+				p = evict_own(cache);
+				lock.lock();
+			}
+			if (!p && cache->purgeable && s.max_pages > 0 && s.clock.size() >= s.max_pages) {
+				// the budget shared by all connections takes any connection's page
+				full = true;
+				p = evict_one(s);
+				if (p && (p->owner->page_size != cache->page_size || p->owner->extra_size != cache->extra_size)) {
+					sqlite3_free(p);
+					p = nullptr;
+				}
+			}
+			if (full && !p && create_flag == 1) { return nullptr; }
+			if (!p) {
+				p = static_cast<page*>(sqlite3_malloc64(sizeof(page) + cache->page_size + cache->extra_size));
+				if (!p) { return nullptr; }
+			}
+
+			uint8_t* buffer = reinterpret_cast<uint8_t*>(p + 1);
+			p->base.pBuf = buffer;
+			p->base.pExtra = buffer + cache->page_size;
+			std::memset(p->base.pExtra, 0, cache->extra_size);
+			p->owner = cache;
+			p->key = key;
+			p->pinned = true;
+			p->referenced = true;
+			add_page(s, p);
+			return &p->base;
+		}
+
+		page* page_of(sqlite3_pcache_page* base) {
+			// base is the first member of page
+			return reinterpret_cast<page*>(base);
+		}
+
+		void page_cache_unpin(sqlite3_pcache* /* cache */, sqlite3_pcache_page* base, int discard) {
+			page* p = page_of(base);
+			shard& s = shard_of(p->owner, p->key);
+			std::lock_guard<std::mutex> lock(s.mutex);
+			if (discard) {
+				free_page(s, p);
+			}
+			else {
+				p->pinned = false;
+			}
+		}
+
+		void page_cache_rekey(sqlite3_pcache* /* cache */, sqlite3_pcache_page* base, unsigned old_key, unsigned new_key) {
+			page* p = page_of(base);
+			cache_instance* cache = p->owner;
+			shard& from = shard_of(cache, old_key);
+			shard& to = shard_of(cache, new_key);
+
+			std::unique_lock<std::mutex> lock_from(from.mutex, std::defer_lock);
+			std::unique_lock<std::mutex> lock_to(to.mutex, std::defer_lock);
+			if (&from == &to) {
+				lock_from.lock();
+			}
+			else {
+				std::lock(lock_from, lock_to);
+			}
+
+			// any page already at new_key is unpinned and is discarded
+			auto existing = to.pages.find(page_id(cache, new_key));
+			if (existing != to.pages.end()) {
+				free_page(to, existing->second);
+			}
+
+			remove_page(from, p);
+			p->key = new_key;
+			add_page(to, p);
+		}
+
+		// drop pages of cache with key >= limit, pinned or not
+		void page_cache_truncate(sqlite3_pcache* pcache, unsigned limit) {
+			cache_instance* cache = instance(pcache);
+			for (auto& s : shards) {
+				std::lock_guard<std::mutex> lock(s->mutex);
+				for (size_t i = 0; i < s->clock.size(); ) {
+					page* p = s->clock[i];
+					if (p->owner == cache && p->key >= limit) {
+						// the last page is swapped into position i
+						free_page(*s, p);
+					}
+					else {
+						++i;
+					}
+				}
+			}
+		}
+
+		void page_cache_destroy(sqlite3_pcache* pcache) {
+			page_cache_truncate(pcache, 0);
+			delete instance(pcache);
+		}
+
+		void page_cache_shrink(sqlite3_pcache* pcache) {
+			cache_instance* cache = instance(pcache);
+			if (!cache->purgeable) { return; }
+
+			for (auto& s : shards) {
+				std::lock_guard<std::mutex> lock(s->mutex);
+				for (size_t i = 0; i < s->clock.size(); ) {
+					page* p = s->clock[i];
+					if (p->owner == cache && !p->pinned) {
+						free_page(*s, p);
+					}
+					else {
+						++i;
+					}
+				}
+			}
+		}
+
+		sqlite3_pcache_methods2 page_cache_methods = {
+			1, nullptr, page_cache_init, page_cache_shutdown, page_cache_create, page_cache_cachesize,
+			page_cache_pagecount, page_cache_fetch, page_cache_unpin, page_cache_rekey, page_cache_truncate,
+			page_cache_destroy, page_cache_shrink
+		};
+
+		// page cache in use before this one was installed
+		bool installed = false;
+		sqlite3_pcache_methods2 previous_methods;
+
+	} // anonymous namespace
+
+	int configure_page_cache(const page_cache_options& options) {
+		if (!options.enabled) {
+			if (!installed) { return SQLITE_OK; }
+
+			int rc = sqlite3_config(SQLITE_CONFIG_PCACHE2, &previous_methods);
+			if (rc == SQLITE_OK) {
+				installed = false;
+			}
+			return rc;
+		}
+
+		if (!installed) {
+			int rc = sqlite3_config(SQLITE_CONFIG_GETPCACHE2, &previous_methods);
+			if (rc != SQLITE_OK) { return rc; }
+		}
+		int rc = sqlite3_config(SQLITE_CONFIG_PCACHE2, &page_cache_methods);
+		if (rc != SQLITE_OK) { return rc; }
+		installed = true;
+
+		// sqlite is not initialised so no cache exists and the shards can be replaced
+		const size_t count = std::max<size_t>(options.shards, 1);
+		shards.clear();
+		for (size_t i = 0; i < count; ++i) {
+			shards.push_back(std::make_unique<shard>());
+			shards.back()->max_pages = options.max_pages == 0 ? 0 : std::max<size_t>(options.max_pages / count, 1);
+		}
+		return SQLITE_OK;
+	}
+
+	page_cache_statistics get_page_cache_statistics() {
+		page_cache_statistics statistics;
+		for (auto& s : shards) {
+			std::lock_guard<std::mutex> lock(s->mutex);
+			statistics.hits += s->hits;
+			statistics.misses += s->misses;
+			statistics.evictions += s->evictions;
+			statistics.pages += s->clock.size();
+		}
+		return statistics;
+	}
+
+} // sql
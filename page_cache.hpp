@@ -0,0 +1,72 @@
+/*
+sqlite - a thin c++ wrapper of sqlite c library
+version 0.0.1
+https://github.com/arcomber/sqlite_cpp
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2021 Angus Comber
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef PAGE_CACHE_HPP_
+#define PAGE_CACHE_HPP_
+
+#include "sqlite3.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sql {
+
+	/*
+	process wide page cache module for sqlite, installed with SQLITE_CONFIG_PCACHE2, see
+	https://sqlite.org/c3ref/pcache_methods2.html. the pages of every connection live in one
+	set of lock striped shards, so connections on different threads rarely wait on the same
+	mutex. unpinned pages are replaced with the CLOCK algorithm, a page touched since the hand
+	last passed it gets a second chance. max_pages bounds the pages of all connections together,
+	on top of each connection's own cache_size.
+	sqlite keeps per connection b-tree state in every cached page so pages are never shared
+	between connections, the budget is shared instead: pages of an idle connection are evicted
+	to make room for a busy one. a connection reaching its own cache_size only reuses its own pages.
+	*/
+	struct page_cache_options {
+		// false puts back the page cache in use before this one was installed
+		bool enabled = true;
+		// number of lock stripes, rounded up to at least 1
+		size_t shards = 16;
+		// limit on cached pages across all connections, 0 for no limit beyond cache_size.
+		// each shard enforces its share so the limit is approximate
+		size_t max_pages = 0;
+	};
+
+	/* install or remove the page cache. like configure_memory, sqlite only accepts this before it
+	is initialised or after sqlite3_shutdown, otherwise SQLITE_MISUSE is returned */
+	int configure_page_cache(const page_cache_options& options);
+
+	/* counters of the installed page cache, summed over its shards */
+	struct page_cache_statistics {
+		uint64_t hits = 0;        // fetch found the page
+		uint64_t misses = 0;      // fetch did not find the page
+		uint64_t evictions = 0;   // unpinned pages reused to make room
+		size_t pages = 0;         // pages held now
+	};
+
+	page_cache_statistics get_page_cache_statistics();
+
+} // sql
+
+#endif // PAGE_CACHE_HPP_
@@ -0,0 +1,151 @@
+#include "parallel_scan.hpp"
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <thread>
+
+namespace sql {
+
+	namespace {
+
+		// the caller's condition with any leading WHERE removed
+		std::string where_condition(const std::string& where_clause) {
+			size_t start = where_clause.find_first_not_of(" \t\r\n");
+			if (start == std::string::npos) { return ""; }
+
+			const std::string keyword = "where";
+			if (where_clause.size() - start > keyword.size() &&
+				std::equal(keyword.begin(), keyword.end(), where_clause.begin() + start,
+					[](char k, char c) { return k == std::tolower(static_cast<unsigned char>(c)); }) &&
+				std::isspace(static_cast<unsigned char>(where_clause[start + keyword.size()]))) {
+				start += keyword.size();
+			}
+			return where_clause.substr(start);
+		}
+
+		// even split of [first, last] into up to count ranges
+		std::vector<scan_partition> split_rowids(int64_t first, int64_t last, size_t count) {
+			// unsigned so the span of the full int64_t range does not overflow
+			const uint64_t span = static_cast<uint64_t>(last) - static_cast<uint64_t>(first);
+			const uint64_t values = span == UINT64_MAX ? span : span + 1;
+			const uint64_t parts = std::min<uint64_t>(count, values);
+
+			std::vector<scan_partition> partitions(static_cast<size_t>(parts));
+			uint64_t start = static_cast<uint64_t>(first);
+			for (uint64_t i = 0; i < parts; ++i) {
+				const uint64_t length = values / parts + (i < values % parts ? 1 : 0);
+				partitions[i].first_rowid = static_cast<int64_t>(start);
+				partitions[i].last_rowid = static_cast<int64_t>(start + length - 1);
+				start += length;
+			}
+			partitions.back().last_rowid = last;
+			return partitions;
+		}
+
+		int64_t as_int64(const sqlite_data_type& value) {
+			if (const int* i = std::get_if<int>(&value)) { return *i; }
+			return std::get<int64_t>(value);
+		}
+
+	} // anonymous namespace
+
+	double scan_report::skew() const {
+		if (partitions.empty()) { return 1.0; }
+
+		std::chrono::microseconds total(0), slowest(0);
+		for (const scan_partition& partition : partitions) {
+			total += partition.elapsed;
+			slowest = std::max(slowest, partition.elapsed);
+		}
+		if (total.count() == 0) { return 1.0; }
+		return static_cast<double>(slowest.count()) * partitions.size() / total.count();
+	}
+
+	size_t scan_report::rows() const {
+		size_t total = 0;
+		for (const scan_partition& partition : partitions) {
+			total += partition.rows;
+		}
+		return total;
+	}
+
+	int parallel_scan(connection_pool& pool,
+		const std::string& table_name,
+		const std::vector<std::string>& column_names,
+		const std::string& where_clause,
+		const std::vector<where_binding>& where_bindings,
+		size_t num_workers,
+		const scan_callback& row_callback,
+		scan_report& report,
+		std::chrono::milliseconds acquire_timeout) {
+		report = scan_report();
+		num_workers = std::min(std::max<size_t>(num_workers, 1), pool.reader_count());
+		if (num_workers == 0) { return SQLITE_MISUSE; }
+
+		std::vector<connection_pool::lease> readers(num_workers);
+		for (auto& reader : readers) {
+			int rc = pool.acquire_reader(reader, acquire_timeout);
+			if (rc != SQLITE_OK) { return rc; }
+		}
+
+		// pin every reader to the same point in time before reading the rowid bounds
+#if defined(SQLITE_ENABLE_SNAPSHOT)
+		std::vector<std::unique_ptr<snapshot_read>> reads;
+		snapshot at;
+		for (auto& reader : readers) {
+			reads.push_back(std::make_unique<snapshot_read>(*reader));
+			int rc = reads.size() == 1 ? reads.back()->begin() : reads.back()->begin(at);
+			if (rc == SQLITE_OK && reads.size() == 1) {
+				rc = reads.back()->capture(at);
+			}
+			if (rc != SQLITE_OK) { return rc; }
+		}
+		report.consistent = true;
+#endif
+
+		const std::vector<std::string> bounds_columns{ "min(rowid)", "max(rowid)" };
+		const std::vector<where_binding> no_bindings;
+		std::vector<std::map<std::string, sqlite_data_type>> bounds;
+		int rc = readers[0]->select_columns(table_name, bounds_columns.begin(), bounds_columns.end(), "",
+			no_bindings.begin(), no_bindings.end(), bounds);
+		if (rc != SQLITE_OK) { return rc; }
+
+		// an empty table has NULL bounds
+		if (bounds.empty() || std::holds_alternative<std::monostate>(bounds[0]["min(rowid)"])) { return SQLITE_OK; }
+
+		report.partitions = split_rowids(as_int64(bounds[0]["min(rowid)"]), as_int64(bounds[0]["max(rowid)"]), num_workers);
+
+		const std::string condition = where_condition(where_clause);
+		const std::string range_where = "WHERE rowid BETWEEN :parallel_scan_first AND :parallel_scan_last" +
+			(condition.empty() ? std::string() : " AND (" + condition + ")");
+
+		std::vector<std::thread> workers;
+		for (size_t i = 0; i < report.partitions.size(); ++i) {
+			workers.emplace_back([&, i] {
+				scan_partition& partition = report.partitions[i];
+				std::vector<where_binding> bindings(where_bindings);
+				bindings.push_back({ "parallel_scan_first", partition.first_rowid });
+				bindings.push_back({ "parallel_scan_last", partition.last_rowid });
+
+				const auto started = std::chrono::steady_clock::now();
+				partition.rc = readers[i]->select_for_each(table_name, column_names.begin(), column_names.end(),
+					range_where, bindings.begin(), bindings.end(), [&](const row_view& row) {
+					++partition.rows;
+					return row_callback(i, row);
+				});
+				partition.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+			});
+		}
+		for (auto& worker : workers) {
+			worker.join();
+		}
+
+		for (const scan_partition& partition : report.partitions) {
+			if (partition.rc != SQLITE_OK) { return partition.rc; }
+		}
+		return SQLITE_OK;
+	}
+
+} // sql
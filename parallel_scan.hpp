@@ -0,0 +1,84 @@
+/*
+sqlite - a thin c++ wrapper of sqlite c library
+version 0.0.1
+https://github.com/arcomber/sqlite_cpp
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2021 Angus Comber
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef PARALLEL_SCAN_HPP_
+#define PARALLEL_SCAN_HPP_
+
+#include "connection_pool.hpp"
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace sql {
+
+	/* timing and outcome of one rowid range of a parallel_scan */
+	struct scan_partition {
+		int64_t first_rowid = 0;
+		int64_t last_rowid = 0;
+		size_t rows = 0;
+		std::chrono::microseconds elapsed{ 0 };
+		int rc = SQLITE_OK;
+	};
+
+	struct scan_report {
+		std::vector<scan_partition> partitions;
+		/* true if every partition read the same snapshot, see snapshot.hpp */
+		bool consistent = false;
+
+		/* slowest partition time over the mean partition time, 1.0 when perfectly even */
+		double skew() const;
+		/* rows visited over all partitions */
+		size_t rows() const;
+	};
+
+	/* called on the worker thread of partition for each row. rows of one partition are
+	visited in turn so partition can index per worker sinks without locking. returning false
+	stops that partition */
+	using scan_callback = std::function<bool(size_t partition, const row_view& row)>;
+
+	/*
+	SELECT column_names FROM table_name where_clause split into rowid ranges which are read in
+	parallel, each on its own pooled reader connection and thread. the range min(rowid) to
+	max(rowid) is split evenly into one partition per worker, up to the pool's reader count.
+	where_clause, eg "WHERE contactid=:contactid", may only hold a condition as it is combined
+	with the rowid range, and table_name must be a rowid table.
+	with SQLITE_ENABLE_SNAPSHOT all partitions read one snapshot, otherwise each reads its own
+	transaction and the scan is only consistent if nothing writes while it runs.
+	returns SQLITE_OK or the first error of any partition, report holds per partition results.
+	*/
+	int parallel_scan(connection_pool& pool,
+		const std::string& table_name,
+		const std::vector<std::string>& column_names,
+		const std::string& where_clause,
+		const std::vector<where_binding>& where_bindings,
+		size_t num_workers,
+		const scan_callback& row_callback,
+		scan_report& report,
+		std::chrono::milliseconds acquire_timeout = std::chrono::milliseconds(5000));
+
+} // sql
+
+#endif // PARALLEL_SCAN_HPP_
@@ -0,0 +1,332 @@
+/*
+sqlite - a thin c++ wrapper of sqlite c library
+version 0.0.1
+https://github.com/arcomber/sqlite_cpp
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2021 Angus Comber
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+compile time table descriptions. A table is described by a name type and the column types
+it is used with, for example:
+
+	namespace contacts_columns {
+		SQLITE_COLUMN(name, std::string);
+		SQLITE_COLUMN(company, std::string);
+	}
+	SQLITE_TABLE_NAME(contacts);
+	using contacts_table = sql::table<contacts, contacts_columns::name, contacts_columns::company>;
+
+The INSERT, UPDATE, SELECT and DELETE sql for the table is generated at compile time and rows
+are bound as std::tuple of the column C++ types, so a misspelt column or a value of the
+wrong type fails to compile. The generated sql addresses rows by rowid.
+*/
+
+#ifndef SCHEMA_HPP_
+#define SCHEMA_HPP_
+
+#include "sqlite3.h"
+
+#include <string>
+#include <vector>
+#include <tuple>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <optional>
+
+/* declare column descriptor id, the sql column name is the identifier itself */
+#define SQLITE_COLUMN(id, cpp_type) \
+struct id { \
+    static constexpr const char name[] = #id; \
+    using type = cpp_type; \
+}
+
+/* declare table name descriptor id, the sql table name is the identifier itself */
+#define SQLITE_TABLE_NAME(id) \
+struct id { \
+    static constexpr const char name[] = #id; \
+}
+
+namespace sql {
+
+	/* bind one typed value to parameter idx. text and blobs are bound SQLITE_STATIC so the
+	value must outlive the step */
+	inline int bind_column(sqlite3_stmt* stmt, int idx, int value) { return sqlite3_bind_int(stmt, idx, value); }
+	inline int bind_column(sqlite3_stmt* stmt, int idx, int64_t value) { return sqlite3_bind_int64(stmt, idx, value); }
+	inline int bind_column(sqlite3_stmt* stmt, int idx, double value) { return sqlite3_bind_double(stmt, idx, value); }
+	inline int bind_column(sqlite3_stmt* stmt, int idx, const std::string& value) {
+		return sqlite3_bind_text64(stmt, idx, value.data(), value.size(), SQLITE_STATIC, SQLITE_UTF8);
+	}
+	inline int bind_column(sqlite3_stmt* stmt, int idx, const std::vector<uint8_t>& value) {
+		return sqlite3_bind_blob64(stmt, idx, value.data(), value.size(), SQLITE_STATIC);
+	}
+
+	/* read result column col of the current row as the given type */
+	inline void read_column(sqlite3_stmt* stmt, int col, int& value) { value = sqlite3_column_int(stmt, col); }
+	inline void read_column(sqlite3_stmt* stmt, int col, int64_t& value) { value = sqlite3_column_int64(stmt, col); }
+	inline void read_column(sqlite3_stmt* stmt, int col, double& value) { value = sqlite3_column_double(stmt, col); }
+	inline void read_column(sqlite3_stmt* stmt, int col, std::string& value) {
+		const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
+		value.assign(text ? text : "", text ? sqlite3_column_bytes(stmt, col) : 0);
+	}
+	inline void read_column(sqlite3_stmt* stmt, int col, std::vector<uint8_t>& value) {
+		const uint8_t* blob = reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, col));
+		value.assign(blob, blob ? blob + sqlite3_column_bytes(stmt, col) : blob);
+	}
+
+	/* a NULL value binds and reads as an empty optional */
+	template <typename T>
+	int bind_column(sqlite3_stmt* stmt, int idx, const std::optional<T>& value) {
+		return value ? bind_column(stmt, idx, *value) : sqlite3_bind_null(stmt, idx);
+	}
+
+	template <typename T>
+	void read_column(sqlite3_stmt* stmt, int col, std::optional<T>& value) {
+		if (sqlite3_column_type(stmt, col) == SQLITE_NULL) {
+			value.reset();
+		}
+		else {
+			read_column(stmt, col, value.emplace());
+		}
+	}
+
+	/* column type affinity, see https://sqlite.org/datatype3.html */
+	enum class affinity { none, integer, real, text, blob, numeric };
+
+	/* affinity of a declared column type, eg from sqlite3_column_decltype. a missing
+	declared type, eg an expression result, gives affinity::none */
+	inline affinity declared_affinity(const char* declared_type) {
+		if (declared_type == nullptr || *declared_type == '\0') { return affinity::none; }
+
+		auto contains = [declared_type](const char* word) {
+			for (const char* start = declared_type; *start; ++start) {
+				const char* a = start;
+				const char* b = word;
+				while (*a && *b && (*a == *b || *a == *b - 'A' + 'a')) { ++a; ++b; }
+				if (*b == '\0') { return true; }
+			}
+			return false;
+		};
+
+		// rules applied in the order sqlite applies them
+		if (contains("INT")) { return affinity::integer; }
+		if (contains("CHAR") || contains("CLOB") || contains("TEXT")) { return affinity::text; }
+		if (contains("BLOB")) { return affinity::blob; }
+		if (contains("REAL") || contains("FLOA") || contains("DOUB")) { return affinity::real; }
+		return affinity::numeric;
+	}
+
+	/* whether a column of affinity a can sensibly be read as C++ type T. columns without a
+	declared type may hold anything so are always accepted */
+	template <typename T>
+	struct column_traits;
+
+	template <> struct column_traits<int> {
+		static bool accepts(affinity a) { return a == affinity::none || a == affinity::integer || a == affinity::numeric; }
+	};
+	template <> struct column_traits<int64_t> : column_traits<int> {};
+	template <> struct column_traits<double> {
+		static bool accepts(affinity a) { return a != affinity::text && a != affinity::blob; }
+	};
+	template <> struct column_traits<std::string> {
+		// NUMERIC covers DATETIME style declarations holding text
+		static bool accepts(affinity a) { return a == affinity::none || a == affinity::text || a == affinity::numeric; }
+	};
+	template <> struct column_traits<std::vector<uint8_t>> {
+		static bool accepts(affinity a) { return a == affinity::none || a == affinity::blob; }
+	};
+	template <typename T> struct column_traits<std::optional<T>> : column_traits<T> {};
+
+	/* check the declared types of a prepared statement's result columns against Ts. returns
+	SQLITE_OK, or SQLITE_MISMATCH if the column count differs or a declared type cannot be read as its T */
+	template <typename... Ts>
+	int check_column_types(sqlite3_stmt* stmt) {
+		if (sqlite3_column_count(stmt) != static_cast<int>(sizeof...(Ts))) { return SQLITE_MISMATCH; }
+
+		int col = 0;
+		bool compatible = true;
+		((compatible = compatible && column_traits<Ts>::accepts(declared_affinity(sqlite3_column_decltype(stmt, col++)))), ...);
+		return compatible ? SQLITE_OK : SQLITE_MISMATCH;
+	}
+
+	namespace detail {
+
+		/* writes sql into out, or when out is nullptr just counts its length */
+		struct sql_writer {
+			char* out = nullptr;
+			size_t pos = 0;
+
+			constexpr void put(const char* s) {
+				for (; *s; ++s, ++pos) {
+					if (out) { out[pos] = *s; }
+				}
+			}
+		};
+
+		template <size_t N>
+		struct static_sql {
+			char text[N + 1]{};
+		};
+
+		/* sql text of builder::write evaluated at compile time, in static storage */
+		template <typename builder>
+		struct compiled_sql {
+			static constexpr size_t length = [] { sql_writer w; builder::write(w); return w.pos; }();
+			static constexpr static_sql<length> value = [] {
+				static_sql<length> s{};
+				sql_writer w{ s.text, 0 };
+				builder::write(w);
+				return s;
+			}();
+		};
+
+		template <typename T, typename... Ts>
+		constexpr size_t index_in_pack() {
+			constexpr bool matches[] = { std::is_same_v<T, Ts>... };
+			for (size_t i = 0; i < sizeof...(Ts); ++i) {
+				if (matches[i]) { return i; }
+			}
+			return sizeof...(Ts);
+		}
+
+		template <typename tuple, size_t... I>
+		int bind_tuple(sqlite3_stmt* stmt, int first_idx, const tuple& values, std::index_sequence<I...>) {
+			int rc = SQLITE_OK;
+			((rc = rc == SQLITE_OK ? bind_column(stmt, first_idx + static_cast<int>(I), std::get<I>(values)) : rc), ...);
+			return rc;
+		}
+
+		template <typename tuple, size_t... I>
+		void read_tuple(sqlite3_stmt* stmt, tuple& values, std::index_sequence<I...>) {
+			(read_column(stmt, static_cast<int>(I), std::get<I>(values)), ...);
+		}
+	}
+
+	/* bind values as parameters first_idx, first_idx + 1, ... */
+	template <typename... Ts>
+	int bind_tuple(sqlite3_stmt* stmt, int first_idx, const std::tuple<Ts...>& values) {
+		return detail::bind_tuple(stmt, first_idx, values, std::index_sequence_for<Ts...>{});
+	}
+
+	/* read result columns 0, 1, ... of the current row into values */
+	template <typename... Ts>
+	void read_tuple(sqlite3_stmt* stmt, std::tuple<Ts...>& values) {
+		detail::read_tuple(stmt, values, std::index_sequence_for<Ts...>{});
+	}
+
+	template <typename table_name, typename... columns>
+	struct table {
+		static_assert(sizeof...(columns) > 0, "a table needs at least one column");
+
+		using row_type = std::tuple<typename columns::type...>;
+		static constexpr size_t column_count = sizeof...(columns);
+
+		/* 1 based sql parameter index of column in insert and update sql. A column not
+		in the table fails to compile */
+		template <typename column>
+		static constexpr int parameter_index() {
+			constexpr size_t pos = detail::index_in_pack<column, columns...>();
+			static_assert(pos < sizeof...(columns), "column is not part of this table");
+			return static_cast<int>(pos + 1);
+		}
+
+		/* INSERT INTO t (c1,c2) VALUES (?,?); */
+		struct insert_sql {
+			static constexpr void write(detail::sql_writer& w) {
+				w.put("INSERT INTO ");
+				w.put(table_name::name);
+				w.put(" (");
+				write_names(w);
+				w.put(") VALUES (");
+				for (size_t i = 0; i < column_count; ++i) {
+					w.put(i == 0 ? "?" : ",?");
+				}
+				w.put(");");
+			}
+		};
+
+		/* UPDATE t SET c1=?,c2=? WHERE rowid=?; rowid is the last parameter */
+		struct update_sql {
+			static constexpr void write(detail::sql_writer& w) {
+				const char* names[] = { columns::name... };
+				w.put("UPDATE ");
+				w.put(table_name::name);
+				w.put(" SET ");
+				for (size_t i = 0; i < column_count; ++i) {
+					w.put(i == 0 ? "" : ",");
+					w.put(names[i]);
+					w.put("=?");
+				}
+				w.put(" WHERE rowid=?;");
+			}
+		};
+
+		/* SELECT c1,c2 FROM t WHERE rowid=?; */
+		struct select_sql {
+			static constexpr void write(detail::sql_writer& w) {
+				select_all_sql::write_select(w);
+				w.put(" WHERE rowid=?;");
+			}
+		};
+
+		/* SELECT c1,c2 FROM t; */
+		struct select_all_sql {
+			static constexpr void write_select(detail::sql_writer& w) {
+				w.put("SELECT ");
+				write_names(w);
+				w.put(" FROM ");
+				w.put(table_name::name);
+			}
+			static constexpr void write(detail::sql_writer& w) {
+				write_select(w);
+				w.put(";");
+			}
+		};
+
+		/* DELETE FROM t WHERE rowid=?; */
+		struct delete_sql {
+			static constexpr void write(detail::sql_writer& w) {
+				w.put("DELETE FROM ");
+				w.put(table_name::name);
+				w.put(" WHERE rowid=?;");
+			}
+		};
+
+		/* generated sql text and its length for one of the statement builders above */
+		template <typename statement>
+		static constexpr const char* sql() { return detail::compiled_sql<statement>::value.text; }
+
+		template <typename statement>
+		static constexpr size_t sql_length() { return detail::compiled_sql<statement>::length; }
+
+	private:
+		static constexpr void write_names(detail::sql_writer& w) {
+			const char* names[] = { columns::name... };
+			for (size_t i = 0; i < column_count; ++i) {
+				w.put(i == 0 ? "" : ",");
+				w.put(names[i]);
+			}
+		}
+	};
+
+} // sql
+
+#endif // SCHEMA_HPP_
@@ -0,0 +1,84 @@
+#include "snapshot.hpp"
+
+#if defined(SQLITE_ENABLE_SNAPSHOT)
+
+#include <utility>
+
+namespace sql {
+
+	snapshot::snapshot(snapshot&& other) noexcept : snapshot_(std::exchange(other.snapshot_, nullptr)) {}
+
+	snapshot& snapshot::operator=(snapshot&& other) noexcept {
+		if (this != &other) {
+			reset();
+			snapshot_ = std::exchange(other.snapshot_, nullptr);
+		}
+		return *this;
+	}
+
+	void snapshot::reset() {
+		if (snapshot_) {
+			sqlite3_snapshot_free(snapshot_);
+			snapshot_ = nullptr;
+		}
+	}
+
+	int snapshot::compare(const snapshot& other) const {
+		return sqlite3_snapshot_cmp(snapshot_, other.snapshot_);
+	}
+
+	int snapshot_read::begin() {
+		int rc = txn_.begin(transaction::mode::deferred);
+		if (rc != SQLITE_OK) { return rc; }
+		if (txn_.nested()) {
+			txn_.rollback();
+			return SQLITE_MISUSE;
+		}
+
+		// BEGIN DEFERRED takes no lock, reading the schema opens the read transaction
+		rc = db_.execute("SELECT count(*) FROM sqlite_master;");
+		if (rc == SQLITE_ROW) {
+			rc = SQLITE_OK;
+		}
+		if (rc != SQLITE_OK) {
+			txn_.rollback();
+		}
+		return rc;
+	}
+
+	int snapshot_read::begin(const snapshot& at) {
+		if (!at) { return SQLITE_MISUSE; }
+
+		int rc = txn_.begin(transaction::mode::deferred);
+		if (rc != SQLITE_OK) { return rc; }
+		if (txn_.nested()) {
+			txn_.rollback();
+			return SQLITE_MISUSE;
+		}
+
+		rc = sqlite3_snapshot_open(db_.db_, "main", at.snapshot_);
+		if (rc != SQLITE_OK) {
+			txn_.rollback();
+		}
+		return rc;
+	}
+
+	int snapshot_read::capture(snapshot& result) {
+		if (!txn_.active()) { return SQLITE_MISUSE; }
+
+		sqlite3_snapshot* taken = nullptr;
+		int rc = sqlite3_snapshot_get(db_.db_, "main", &taken);
+		if (rc == SQLITE_OK) {
+			result.reset();
+			result.snapshot_ = taken;
+		}
+		return rc;
+	}
+
+	int snapshot_read::end() {
+		return txn_.active() ? txn_.commit() : SQLITE_OK;
+	}
+
+} // sql
+
+#endif // SQLITE_ENABLE_SNAPSHOT
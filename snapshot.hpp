@@ -0,0 +1,109 @@
+/*
+sqlite - a thin c++ wrapper of sqlite c library
+version 0.0.1
+https://github.com/arcomber/sqlite_cpp
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2021 Angus Comber
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SNAPSHOT_HPP_
+#define SNAPSHOT_HPP_
+
+#include "sqlite.hpp"
+
+/*
+consistent reads across connections using sqlite3_snapshot. the snapshot interface only
+exists if sqlite3.c is compiled with SQLITE_ENABLE_SNAPSHOT, which the makefiles define, and
+only works on WAL mode databases such as those opened by connection_pool.
+typical use, where every reader sees the same point in time while the writer carries on:
+
+	sql::snapshot_read first(*reader1);
+	first.begin();
+	sql::snapshot at;
+	first.capture(at);
+
+	sql::snapshot_read second(*reader2);
+	second.begin(at);
+
+keep a read open at the snapshot, as first does here, until the others have begun. otherwise a
+checkpoint may move past the snapshot and begin(at) fails with SQLITE_ERROR_SNAPSHOT.
+*/
+
+#if defined(SQLITE_ENABLE_SNAPSHOT)
+
+namespace sql {
+
+	/* a point in time in a WAL database, freed on destruction */
+	class snapshot {
+	public:
+		snapshot() : snapshot_(nullptr) {}
+		~snapshot() { reset(); }
+
+		snapshot(snapshot&& other) noexcept;
+		snapshot& operator=(snapshot&& other) noexcept;
+		snapshot(const snapshot&) = delete;
+		snapshot& operator=(const snapshot&) = delete;
+
+		explicit operator bool() const { return snapshot_ != nullptr; }
+
+		void reset();
+
+		/* negative, zero or positive if this snapshot is older, the same or newer than other.
+		both must be of the same database */
+		int compare(const snapshot& other) const;
+
+	private:
+		friend class snapshot_read;
+		sqlite3_snapshot* snapshot_;
+	};
+
+	/* read transaction on one connection, either at the current state of the database or
+	at a snapshot. the transaction is ended on destruction */
+	class snapshot_read {
+	public:
+		explicit snapshot_read(sqlite& db) : db_(db), txn_(db) {}
+
+		snapshot_read(const snapshot_read&) = delete;
+		snapshot_read& operator=(const snapshot_read&) = delete;
+
+		/* begin reading at the current state of the database */
+		int begin();
+
+		/* begin reading at. returns SQLITE_ERROR_SNAPSHOT if the database has been
+		checkpointed past it, SQLITE_MISUSE if at is empty */
+		int begin(const snapshot& at);
+
+		/* record the state this read sees into result. the read must be begun */
+		int capture(snapshot& result);
+
+		/* end the read transaction */
+		int end();
+
+		bool active() const { return txn_.active(); }
+
+	private:
+		sqlite& db_;
+		transaction txn_;
+	};
+
+} // sql
+
+#endif // SQLITE_ENABLE_SNAPSHOT
+
+#endif // SNAPSHOT_HPP_
@@ -1,7 +1,9 @@
 #include "sqlite.hpp"
 
 #include <algorithm>
+#include <cstdlib>
 #include <iomanip>
+#include <limits>
 #include <iostream>
 #include <sstream>
 
@@ -29,6 +31,10 @@ namespace sql {
 #endif
 			break;
 		}
+		case 4: os << std::get<4>(v.column_value) << " of type int64_t"; break;
+		case 5: os << "null"; break;
+		case 6: os << std::get<6>(v.column_value) << " of type zeroblob"; break;
+		case 7: os << std::get<7>(v.column_value) << " of type blob_view"; break;
 		}
 
 		return os;
@@ -50,6 +56,24 @@ namespace sql {
 		return os;
 	}
 
+	std::ostream& operator<<(std::ostream& os, const std::monostate& /* v */)
+	{
+		os << "null";
+		return os;
+	}
+
+	std::ostream& operator<<(std::ostream& os, const zeroblob& v)
+	{
+		os << "<zeroblob " << v.size << '>';
+		return os;
+	}
+
+	std::ostream& operator<<(std::ostream& os, const blob_view& v)
+	{
+		os << "<blob view " << v.size() << " bytes>";
+		return os;
+	}
+
 	std::ostream& operator<<(std::ostream& os, const sqlite_data_type& v)
 	{
 		std::visit([&](const auto& element) {
@@ -68,7 +92,511 @@ namespace sql {
 		return os;
 	}
 
-	sqlite::sqlite() : db_(nullptr) {}
+	std::vector<std::string> get_column_names(sqlite3_stmt* stmt) {
+		int num_cols = sqlite3_column_count(stmt);
+
+		std::vector<std::string> column_names;
+		column_names.reserve(num_cols);
+		for (int i = 0; i < num_cols; i++) {
+			const char* colname = sqlite3_column_name(stmt, i);
+			column_names.push_back(colname ? colname : "");
+		}
+		return column_names;
+	}
+
+	void read_row(sqlite3_stmt* stmt, const std::vector<std::string>& column_names, std::map<std::string, sqlite_data_type>& row) {
+		const int num_cols = static_cast<int>(column_names.size());
+
+		for (int i = 0; i < num_cols; i++)
+		{
+			switch (sqlite3_column_type(stmt, i))
+			{
+			case SQLITE3_TEXT:
+			{
+				const unsigned char* value = sqlite3_column_text(stmt, i);
+				int len = sqlite3_column_bytes(stmt, i);
+				row[column_names[i]] = std::string(value, value + len);
+			}
+			break;
+			case SQLITE_INTEGER:
+			{
+				// int where it fits so values compare equal to those inserted as int
+				const int64_t value = sqlite3_column_int64(stmt, i);
+				if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max()) {
+					row[column_names[i]] = static_cast<int>(value);
+				}
+				else {
+					row[column_names[i]] = value;
+				}
+			}
+			break;
+			case SQLITE_FLOAT:
+			{
+				row[column_names[i]] = sqlite3_column_double(stmt, i);
+			}
+			break;
+			case SQLITE_BLOB:
+			{
+				const uint8_t* value = reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, i));
+				int len = sqlite3_column_bytes(stmt, i);
+				row[column_names[i]] = std::vector<uint8_t>(value, value + len);
+			}
+			break;
+			case SQLITE_NULL:
+			{
+				row[column_names[i]] = std::monostate{};
+			}
+			break;
+			default:
+				break;
+			}
+		}
+	}
+
+	void read_row(sqlite3_stmt* stmt, const std::pmr::vector<std::string_view>& column_names, pmr_row& row) {
+		std::pmr::memory_resource* resource = row.get_allocator().resource();
+		const int num_cols = static_cast<int>(column_names.size());
+
+		for (int i = 0; i < num_cols; i++)
+		{
+			// the key is constructed with the map's memory_resource
+			pmr_data_type& cell = row.emplace(std::piecewise_construct,
+				std::forward_as_tuple(column_names[i].data(), column_names[i].size()), std::forward_as_tuple()).first->second;
+
+			switch (sqlite3_column_type(stmt, i))
+			{
+			case SQLITE3_TEXT:
+			{
+				const char* value = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
+				int len = sqlite3_column_bytes(stmt, i);
+				cell.emplace<std::pmr::string>(value, len, resource);
+			}
+			break;
+			case SQLITE_INTEGER:
+			{
+				const int64_t value = sqlite3_column_int64(stmt, i);
+				if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max()) {
+					cell = static_cast<int>(value);
+				}
+				else {
+					cell = value;
+				}
+			}
+			break;
+			case SQLITE_FLOAT:
+				cell = sqlite3_column_double(stmt, i);
+				break;
+			case SQLITE_BLOB:
+			{
+				const uint8_t* value = reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, i));
+				int len = sqlite3_column_bytes(stmt, i);
+				cell.emplace<std::pmr::vector<uint8_t>>(value, value + len, resource);
+			}
+			break;
+			case SQLITE_NULL:
+				cell = std::monostate{};
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	namespace {
+		// bring a lazily populated array up to row entries
+		template <typename T>
+		void pad_to(std::vector<T>& values, size_t rows) {
+			if (values.size() < rows) {
+				values.resize(rows);
+			}
+		}
+
+		// offsets repeat the last end position for rows which have no cell of this type
+		void pad_offsets_to(std::vector<size_t>& offsets, size_t rows) {
+			if (offsets.empty()) {
+				offsets.push_back(0);
+			}
+			if (offsets.size() < rows + 1) {
+				offsets.resize(rows + 1, offsets.back());
+			}
+		}
+	}
+
+	size_t columnar_result::column_index(const std::string& name) const {
+		return static_cast<size_t>(std::find(column_names_.begin(), column_names_.end(), name) - column_names_.begin());
+	}
+
+	int64_t columnar_result::get_int64(size_t col, size_t row) const {
+		const column& c = columns_[col];
+		return row < c.integers.size() ? c.integers[row] : 0;
+	}
+
+	double columnar_result::get_double(size_t col, size_t row) const {
+		const column& c = columns_[col];
+		return row < c.reals.size() ? c.reals[row] : 0.0;
+	}
+
+	std::string_view columnar_result::get_text(size_t col, size_t row) const {
+		const column& c = columns_[col];
+		if (row + 1 >= c.text_offsets.size()) { return {}; }
+		return std::string_view(c.text.data() + c.text_offsets[row], c.text_offsets[row + 1] - c.text_offsets[row]);
+	}
+
+	blob_view columnar_result::get_blob(size_t col, size_t row) const {
+		const column& c = columns_[col];
+		if (row + 1 >= c.blob_offsets.size()) { return {}; }
+		return blob_view{ c.blobs.data() + c.blob_offsets[row], c.blob_offsets[row + 1] - c.blob_offsets[row] };
+	}
+
+	void columnar_result::clear() {
+		column_names_.clear();
+		columns_.clear();
+		rows_ = 0;
+	}
+
+	void columnar_result::reset(std::vector<std::string> column_names) {
+		column_names_ = std::move(column_names);
+		columns_.assign(column_names_.size(), column{});
+		rows_ = 0;
+	}
+
+	void columnar_result::append_row(sqlite3_stmt* stmt) {
+		for (size_t i = 0; i < columns_.size(); ++i) {
+			column& c = columns_[i];
+			const int col = static_cast<int>(i);
+			const int type = sqlite3_column_type(stmt, col);
+
+			c.types.push_back(static_cast<uint8_t>(type));
+			if (rows_ % 64 == 0) {
+				c.null_bits.push_back(0);
+			}
+
+			switch (type) {
+			case SQLITE_INTEGER:
+				pad_to(c.integers, rows_);
+				c.integers.push_back(sqlite3_column_int64(stmt, col));
+				break;
+			case SQLITE_FLOAT:
+				pad_to(c.reals, rows_);
+				c.reals.push_back(sqlite3_column_double(stmt, col));
+				break;
+			case SQLITE3_TEXT:
+			{
+				const char* value = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
+				int len = sqlite3_column_bytes(stmt, col);
+				pad_offsets_to(c.text_offsets, rows_);
+				c.text.append(value, len);
+				c.text_offsets.push_back(c.text.size());
+			}
+			break;
+			case SQLITE_BLOB:
+			{
+				const uint8_t* value = reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, col));
+				int len = sqlite3_column_bytes(stmt, col);
+				pad_offsets_to(c.blob_offsets, rows_);
+				c.blobs.insert(c.blobs.end(), value, value + len);
+				c.blob_offsets.push_back(c.blobs.size());
+			}
+			break;
+			case SQLITE_NULL:
+				c.null_bits.back() |= uint64_t(1) << (rows_ % 64);
+				break;
+			default:
+				break;
+			}
+		}
+		++rows_;
+	}
+
+	void columnar_result::finish() {
+		for (auto& c : columns_) {
+			if (!c.integers.empty()) { pad_to(c.integers, rows_); }
+			if (!c.reals.empty()) { pad_to(c.reals, rows_); }
+			if (!c.text_offsets.empty()) { pad_offsets_to(c.text_offsets, rows_); }
+			if (!c.blob_offsets.empty()) { pad_offsets_to(c.blob_offsets, rows_); }
+		}
+	}
+
+	statement_cache::statement_cache(size_t capacity) : capacity_(capacity), hits_(0), misses_(0) {}
+
+	statement_cache::~statement_cache() {
+		clear();
+	}
+
+	namespace {
+		parameter_slots resolve_parameters(sqlite3_stmt* stmt) {
+			parameter_slots slots;
+			const int count = sqlite3_bind_parameter_count(stmt);
+			slots.names.reserve(count);
+			for (int i = 1; i <= count; ++i) {
+				// skip the : @ or $ prefix
+				const char* name = sqlite3_bind_parameter_name(stmt, i);
+				slots.names.push_back(name ? name + 1 : "");
+			}
+			return slots;
+		}
+	}
+
+	int statement_cache::acquire(sqlite3* db, const std::string& sql, sqlite3_stmt** stmt, const parameter_slots** slots) {
+		return acquire(db, sql.c_str(), sql.size(), stmt, slots);
+	}
+
+	int statement_cache::acquire(sqlite3* db, const char* sql, size_t length, sqlite3_stmt** stmt, const parameter_slots** slots) {
+		auto found = index_.find(std::string_view(sql, length));
+		return acquire_entry(db, sql, length, nullptr,
+			found == index_.end() ? lru_.end() : found->second, stmt, slots);
+	}
+
+	int statement_cache::acquire_static(sqlite3* db, const char* sql, size_t length, sqlite3_stmt** stmt, const parameter_slots** slots) {
+		auto found = static_index_.find(sql);
+		return acquire_entry(db, sql, length, sql,
+			found == static_index_.end() ? lru_.end() : found->second, stmt, slots);
+	}
+
+	int statement_cache::acquire_entry(sqlite3* db, const char* sql, size_t length, const char* static_sql,
+		std::list<entry>::iterator found, sqlite3_stmt** stmt, const parameter_slots** slots) {
+		static const parameter_slots no_slots;
+		*stmt = nullptr;
+		if (slots) { *slots = &no_slots; }
+
+		if (found != lru_.end() && !found->in_use) {
+			lru_.splice(lru_.begin(), lru_, found);
+			found->in_use = true;
+			*stmt = found->stmt;
+			if (slots) { *slots = &found->slots; }
+			++hits_;
+			return SQLITE_OK;
+		}
+
+		++misses_;
+
+		// a statement with this sql already in use is not replaced, we just prepare a transient one
+		bool cacheable = found == lru_.end() && capacity_ > 0;
+		if (cacheable) {
+			evict_to(capacity_ - 1);
+			cacheable = lru_.size() < capacity_;
+		}
+
+		// passing length including nul terminator saves sqlite copying the sql
+		int rc = sqlite3_prepare_v3(db, sql, static_cast<int>(length + 1),
+			cacheable ? SQLITE_PREPARE_PERSISTENT : 0, stmt, NULL);
+
+		if (rc != SQLITE_OK || *stmt == nullptr) { return rc; }
+
+		std::list<entry>& target = cacheable ? lru_ : transient_;
+		target.push_front({ cacheable && !static_sql ? std::string(sql, length) : std::string(),
+			static_sql, *stmt, true, resolve_parameters(*stmt) });
+		if (cacheable) {
+			if (static_sql) {
+				static_index_.emplace(static_sql, lru_.begin());
+			}
+			else {
+				index_.emplace(std::string_view(lru_.front().sql), lru_.begin());
+			}
+		}
+		if (slots) { *slots = &target.front().slots; }
+		return SQLITE_OK;
+	}
+
+	int statement_cache::release(sqlite3_stmt* stmt) {
+		if (stmt == nullptr) { return SQLITE_OK; }
+
+		int rc = sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+
+		auto same_stmt = [stmt](const entry& e) { return e.stmt == stmt; };
+
+		// statements just acquired are at the front so this is normally found first time
+		auto it = std::find_if(lru_.begin(), lru_.end(), same_stmt);
+		if (it != lru_.end()) {
+			it->in_use = false;
+			return rc;
+		}
+
+		it = std::find_if(transient_.begin(), transient_.end(), same_stmt);
+		if (it != transient_.end()) {
+			transient_.erase(it);
+		}
+		sqlite3_finalize(stmt);
+		return rc;
+	}
+
+	void statement_cache::clear() {
+		for (auto& e : lru_) {
+			sqlite3_finalize(e.stmt);
+		}
+		for (auto& e : transient_) {
+			sqlite3_finalize(e.stmt);
+		}
+		lru_.clear();
+		transient_.clear();
+		index_.clear();
+		static_index_.clear();
+	}
+
+	void statement_cache::set_capacity(size_t capacity) {
+		capacity_ = capacity;
+		evict_to(capacity_);
+	}
+
+	void statement_cache::evict_to(size_t size) {
+		// walk from least recently used, skipping statements still being stepped
+		for (auto it = lru_.end(); lru_.size() > size && it != lru_.begin(); ) {
+			--it;
+			if (!it->in_use) {
+				sqlite3_finalize(it->stmt);
+				if (it->static_sql) {
+					static_index_.erase(it->static_sql);
+				}
+				else {
+					index_.erase(std::string_view(it->sql));
+				}
+				it = lru_.erase(it);
+			}
+		}
+	}
+
+	cursor::cursor() : db_(nullptr), stmt_(nullptr), operation_(traced_operation::none), status_(SQLITE_OK) {}
+
+	cursor::cursor(sqlite* db, sqlite3_stmt* stmt, traced_operation operation)
+		: db_(db), stmt_(stmt), operation_(operation), column_names_(get_column_names(stmt)), status_(SQLITE_OK) {}
+
+	cursor::~cursor() {
+		close();
+	}
+
+	cursor::cursor(cursor&& other) noexcept
+		: db_(other.db_), stmt_(other.stmt_), operation_(other.operation_), column_names_(std::move(other.column_names_)),
+		row_(std::move(other.row_)), status_(other.status_) {
+		other.db_ = nullptr;
+		other.stmt_ = nullptr;
+	}
+
+	cursor& cursor::operator=(cursor&& other) noexcept {
+		if (this != &other) {
+			close();
+			db_ = other.db_;
+			stmt_ = other.stmt_;
+			operation_ = other.operation_;
+			column_names_ = std::move(other.column_names_);
+			row_ = std::move(other.row_);
+			status_ = other.status_;
+			other.db_ = nullptr;
+			other.stmt_ = nullptr;
+		}
+		return *this;
+	}
+
+	cursor::iterator cursor::begin() {
+		if (status_ == SQLITE_OK) {
+			next();
+		}
+		return iterator(this);
+	}
+
+	int cursor::next() {
+		if (stmt_ == nullptr) { return status_ == SQLITE_OK ? SQLITE_MISUSE : status_; }
+		// stepping again after SQLITE_DONE or an error would silently restart the query
+		if (status_ != SQLITE_OK && status_ != SQLITE_ROW) { return status_; }
+
+		// the statement starts running here, after select_cursor has returned
+		sqlite::operation_scope scope(*db_, operation_);
+		status_ = sqlite3_step(stmt_);
+		row_.clear();
+		if (status_ == SQLITE_ROW) {
+			read_row(stmt_, column_names_, row_);
+		}
+		return status_;
+	}
+
+	int cursor::close() {
+		if (stmt_ == nullptr) { return SQLITE_OK; }
+
+		int rc = db_->statements_.release(stmt_);
+		stmt_ = nullptr;
+		db_ = nullptr;
+		// keep status_ so caller can still see how iteration ended
+		return rc;
+	}
+
+	blob_stream::blob_stream(blob_stream&& other) noexcept : blob_(other.blob_) {
+		other.blob_ = nullptr;
+	}
+
+	blob_stream& blob_stream::operator=(blob_stream&& other) noexcept {
+		if (this != &other) {
+			close();
+			blob_ = other.blob_;
+			other.blob_ = nullptr;
+		}
+		return *this;
+	}
+
+	int blob_stream::read(void* buffer, int length, int offset) {
+		if (blob_ == nullptr) { return SQLITE_MISUSE; }
+		return sqlite3_blob_read(blob_, buffer, length, offset);
+	}
+
+	int blob_stream::write(const void* data, int length, int offset) {
+		if (blob_ == nullptr) { return SQLITE_MISUSE; }
+		return sqlite3_blob_write(blob_, data, length, offset);
+	}
+
+	int blob_stream::reopen(int64_t rowid) {
+		if (blob_ == nullptr) { return SQLITE_MISUSE; }
+		return sqlite3_blob_reopen(blob_, rowid);
+	}
+
+	int blob_stream::read_to(std::ostream& out, size_t chunk_size) {
+		if (blob_ == nullptr) { return SQLITE_MISUSE; }
+
+		const int total = size();
+		const int chunk = static_cast<int>(std::min<size_t>(std::max<size_t>(chunk_size, 1), std::numeric_limits<int>::max()));
+		std::vector<char> buffer(static_cast<size_t>(std::min(chunk, total)));
+		for (int offset = 0; offset < total; ) {
+			const int length = std::min(chunk, total - offset);
+			int rc = sqlite3_blob_read(blob_, buffer.data(), length, offset);
+			if (rc != SQLITE_OK) { return rc; }
+
+			if (!out.write(buffer.data(), length)) { return SQLITE_IOERR; }
+			offset += length;
+		}
+		return SQLITE_OK;
+	}
+
+	int blob_stream::write_from(std::istream& in, size_t chunk_size) {
+		if (blob_ == nullptr) { return SQLITE_MISUSE; }
+
+		const int total = size();
+		const int chunk = static_cast<int>(std::min<size_t>(std::max<size_t>(chunk_size, 1), std::numeric_limits<int>::max()));
+		std::vector<char> buffer(static_cast<size_t>(std::min(chunk, total)));
+		int offset = 0;
+		while (offset < total && in) {
+			in.read(buffer.data(), std::min(chunk, total - offset));
+			const int length = static_cast<int>(in.gcount());
+			if (length == 0) { break; }
+
+			int rc = sqlite3_blob_write(blob_, buffer.data(), length, offset);
+			if (rc != SQLITE_OK) { return rc; }
+			offset += length;
+		}
+
+		// anything left over would not fit
+		if (offset == total && in.peek() != std::char_traits<char>::eof()) { return SQLITE_TOOBIG; }
+		return in.bad() ? SQLITE_IOERR : SQLITE_OK;
+	}
+
+	int blob_stream::close() {
+		if (blob_ == nullptr) { return SQLITE_OK; }
+
+		int rc = sqlite3_blob_close(blob_);
+		blob_ = nullptr;
+		return rc;
+	}
+
+	sqlite::sqlite() : db_(nullptr), savepoint_depth_(0), operation_(traced_operation::none),
+		trace_sink_(nullptr), trace_sample_every_(1), trace_countdown_(1),
+		traced_stmt_(nullptr), traced_operation_(traced_operation::none) {}
 
 	sqlite::~sqlite() {
 		close();
@@ -78,16 +606,188 @@ namespace sql {
 		return sqlite3_open(filename.c_str(), &db_);
 	}
 
+	open_options open_options::durable() {
+		open_options options;
+		options.journal_mode = journal::wal;
+		options.synchronous = sync::full;
+		options.busy_timeout_ms = 5000;
+		return options;
+	}
+
+	open_options open_options::high_throughput_ingest() {
+		open_options options;
+		options.journal_mode = journal::wal;
+		options.synchronous = sync::normal;
+		options.cache_size = -64 * 1024;        // 64 MiB
+		options.temp_store = temp::memory;
+		options.busy_timeout_ms = 5000;
+		return options;
+	}
+
+	open_options open_options::read_mostly() {
+		open_options options;
+		options.journal_mode = journal::wal;
+		options.synchronous = sync::normal;
+		options.mmap_size = int64_t(1) << 30;   // 1 GiB
+		options.cache_size = -32 * 1024;        // 32 MiB
+		options.temp_store = temp::memory;
+		options.busy_timeout_ms = 5000;
+		return options;
+	}
+
+	namespace {
+		const char* to_pragma_value(open_options::journal mode) {
+			switch (mode) {
+			case open_options::journal::delete_file: return "DELETE";
+			case open_options::journal::truncate: return "TRUNCATE";
+			case open_options::journal::persist: return "PERSIST";
+			case open_options::journal::memory: return "MEMORY";
+			case open_options::journal::wal: return "WAL";
+			case open_options::journal::off: return "OFF";
+			}
+			return "DELETE";
+		}
+
+		const char* to_pragma_value(open_options::sync mode) {
+			switch (mode) {
+			case open_options::sync::off: return "OFF";
+			case open_options::sync::normal: return "NORMAL";
+			case open_options::sync::full: return "FULL";
+			case open_options::sync::extra: return "EXTRA";
+			}
+			return "FULL";
+		}
+
+		const char* to_pragma_value(open_options::temp mode) {
+			switch (mode) {
+			case open_options::temp::default_store: return "DEFAULT";
+			case open_options::temp::file: return "FILE";
+			case open_options::temp::memory: return "MEMORY";
+			}
+			return "DEFAULT";
+		}
+
+		int64_t to_int64(const std::string& s) {
+			return std::strtoll(s.c_str(), nullptr, 10);
+		}
+
+		int to_open_flags(const open_options& options) {
+			int flags = options.read_only || options.immutable ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+			if (options.no_mutex) { flags |= SQLITE_OPEN_NOMUTEX; }
+			if (options.uri || options.immutable) { flags |= SQLITE_OPEN_URI; }
+			if (options.cache_mode == open_options::cache::private_cache) { flags |= SQLITE_OPEN_PRIVATECACHE; }
+			if (options.cache_mode == open_options::cache::shared_cache) { flags |= SQLITE_OPEN_SHAREDCACHE; }
+			return flags;
+		}
+
+		// immutable can only be requested as a URI parameter
+		std::string to_open_filename(const std::string& filename, const open_options& options) {
+			if (!options.immutable) { return filename; }
+
+			if (options.uri && filename.compare(0, 5, "file:") == 0) {
+				return filename + (filename.find('?') == std::string::npos ? "?" : "&") + "immutable=1";
+			}
+
+			std::string uri{ "file:" };
+			for (char c : filename) {
+				switch (c) {
+				case '%': uri += "%25"; break;
+				case '?': uri += "%3f"; break;
+				case '#': uri += "%23"; break;
+				default: uri += c; break;
+				}
+			}
+			return uri + "?immutable=1";
+		}
+	}
+
+	int sqlite::open(const std::string& filename, const open_options& options) {
+		open_settings applied;
+		return open(filename, options, applied);
+	}
+
+	int sqlite::open(const std::string& filename, const open_options& options, open_settings& applied) {
+		applied = open_settings{};
+
+		int rc = open(to_open_filename(filename, options), to_open_flags(options));
+		if (rc != SQLITE_OK) { return rc; }
+
+		// sqlite allocates the lookaside buffer itself when passed nullptr
+		if (options.lookaside_slot_size && options.lookaside_slot_count) {
+			rc = sqlite3_db_config(db_, SQLITE_DBCONFIG_LOOKASIDE, nullptr,
+				*options.lookaside_slot_size, *options.lookaside_slot_count);
+			if (rc != SQLITE_OK) { return rc; }
+		}
+
+		// page_size first, it can not change once the database is in WAL mode
+		std::vector<std::pair<const char*, std::string>> settings;
+		if (options.page_size) { settings.emplace_back("page_size", std::to_string(*options.page_size)); }
+		if (options.journal_mode) { settings.emplace_back("journal_mode", to_pragma_value(*options.journal_mode)); }
+		if (options.synchronous) { settings.emplace_back("synchronous", to_pragma_value(*options.synchronous)); }
+		if (options.mmap_size) { settings.emplace_back("mmap_size", std::to_string(*options.mmap_size)); }
+		if (options.cache_size) { settings.emplace_back("cache_size", std::to_string(*options.cache_size)); }
+		if (options.temp_store) { settings.emplace_back("temp_store", to_pragma_value(*options.temp_store)); }
+		if (options.busy_timeout_ms) { settings.emplace_back("busy_timeout", std::to_string(*options.busy_timeout_ms)); }
+
+		std::string result;
+		for (const auto& setting : settings) {
+			rc = pragma(setting.first, setting.second, result);
+			if (rc != SQLITE_OK) { return rc; }
+		}
+
+		// read back, sqlite silently ignores some requests, eg WAL on an in-memory database
+		if ((rc = pragma("journal_mode", applied.journal_mode)) != SQLITE_OK) { return rc; }
+		if ((rc = pragma("synchronous", result)) != SQLITE_OK) { return rc; }
+		applied.synchronous = static_cast<int>(to_int64(result));
+		if ((rc = pragma("mmap_size", result)) != SQLITE_OK) { return rc; }
+		applied.mmap_size = to_int64(result);
+		if ((rc = pragma("cache_size", result)) != SQLITE_OK) { return rc; }
+		applied.cache_size = static_cast<int>(to_int64(result));
+		if ((rc = pragma("temp_store", result)) != SQLITE_OK) { return rc; }
+		applied.temp_store = static_cast<int>(to_int64(result));
+		if ((rc = pragma("page_size", result)) != SQLITE_OK) { return rc; }
+		applied.page_size = static_cast<int>(to_int64(result));
+		if ((rc = pragma("busy_timeout", result)) != SQLITE_OK) { return rc; }
+		applied.busy_timeout_ms = static_cast<int>(to_int64(result));
+
+		return SQLITE_OK;
+	}
+
+	int sqlite::open(const std::string& filename, int flags) {
+		return sqlite3_open_v2(filename.c_str(), &db_, flags, nullptr);
+	}
+
 	int sqlite::close() {
 		if (db_ == nullptr) { return SQLITE_ERROR; }
 
+		// sqlite3_close fails with SQLITE_BUSY if any statements are not finalised
+		statements_.clear();
+
 		int rc = sqlite3_close(db_);
 		db_ = nullptr;
+		trace_sink_ = nullptr;
+		traced_stmt_ = nullptr;
 		return rc;
 	}
 
-	int sqlite::last_insert_rowid() {
-		return static_cast<int>(sqlite3_last_insert_rowid(db_));
+	int64_t sqlite::last_insert_rowid() {
+		return sqlite3_last_insert_rowid(db_);
+	}
+
+	int sqlite::open_blob(const std::string& table_name, const std::string& column, int64_t rowid,
+		bool writable, blob_stream& result) {
+		result.close();
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+
+		sqlite3_blob* blob = nullptr;
+		int rc = sqlite3_blob_open(db_, "main", table_name.c_str(), column.c_str(), rowid, writable ? 1 : 0, &blob);
+		if (rc != SQLITE_OK) {
+			// sqlite may hand back a handle even on failure
+			sqlite3_blob_close(blob);
+			return rc;
+		}
+		result = blob_stream(blob);
+		return SQLITE_OK;
 	}
 
 	int sqlite::delete_from(const std::string& table_name) {
@@ -101,6 +801,33 @@ namespace sql {
 		return select_star(table_name, "", empty.begin(), empty.end(), results);
 	}
 
+	int sqlite::pragma(const std::string& name, const std::string& value, std::string& result) {
+		return pragma(value.empty() ? name : name + "=" + value, result);
+	}
+
+	int sqlite::pragma(const std::string& name, std::string& result) {
+		result.clear();
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::pragma);
+
+		// pragma values can not be bound as parameters so name and value form the sql. each
+		// pragma is usually run once, so it is finalised at once rather than cached where it
+		// would push out the statements which are reused
+		const std::string sql = "PRAGMA " + name + ";";
+		sqlite3_stmt* stmt = NULL;
+		int rc = sqlite3_prepare_v2(db_, sql.c_str(), static_cast<int>(sql.size()), &stmt, nullptr);
+		if (rc != SQLITE_OK) { return rc; }
+
+		rc = sqlite3_step(stmt);
+		if (rc == SQLITE_ROW && sqlite3_column_count(stmt) > 0) {
+			const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+			result = text ? text : "";
+		}
+
+		int finalize_rc = sqlite3_finalize(stmt);
+		return rc == SQLITE_ROW || rc == SQLITE_DONE ? finalize_rc : rc;
+	}
+
 	const std::string sqlite::get_last_error_description() {
 		if (db_ == nullptr) { return ""; }
 
@@ -109,17 +836,182 @@ namespace sql {
 		return s;
 	}
 
-	int sqlite::step_and_finalise(sqlite3_stmt* stmt) {
+	void sqlite::interrupt() {
+		if (db_ != nullptr) {
+			sqlite3_interrupt(db_);
+		}
+	}
+
+	void sqlite::set_statement_cache_capacity(size_t capacity) {
+		statements_.set_capacity(capacity);
+	}
+
+	uint64_t sqlite::statement_cache_hits() const {
+		return statements_.hits();
+	}
+
+	uint64_t sqlite::statement_cache_misses() const {
+		return statements_.misses();
+	}
+
+	int sqlite::set_trace(trace_sink* sink, uint32_t sample_every) {
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		if (sample_every == 0) { return SQLITE_MISUSE; }
+
+		trace_sink_ = sink;
+		trace_sample_every_ = sample_every;
+		trace_countdown_ = 1;
+		traced_stmt_ = nullptr;
+
+		// with no sink sqlite neither times statements nor calls back
+		if (sink == nullptr) {
+			return sqlite3_trace_v2(db_, 0, nullptr, nullptr);
+		}
+		return sqlite3_trace_v2(db_, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE, &sqlite::trace_callback, this);
+	}
+
+	int sqlite::trace_callback(unsigned type, void* context, void* p, void* x) {
+		sqlite& db = *static_cast<sqlite*>(context);
+		sqlite3_stmt* stmt = static_cast<sqlite3_stmt*>(p);
+
+		if (type == SQLITE_TRACE_STMT) {
+			// also reported at the start of each trigger as "-- TRIGGER name", sample only the
+			// statement itself. the decision is made here so unsampled statements are never expanded
+			const char* text = static_cast<const char*>(x);
+			if (text != nullptr && text[0] == '-' && text[1] == '-') { return 0; }
+
+			if (db.trace_countdown_ > 1) {
+				--db.trace_countdown_;
+				return 0;
+			}
+			// one sampled statement at a time. while one is still running, eg the select of
+			// select_for_each whose visitor runs other statements, the sample waits for the next one
+			if (db.traced_stmt_ != nullptr) { return 0; }
+
+			db.trace_countdown_ = db.trace_sample_every_;
+			db.traced_stmt_ = stmt;
+			db.traced_operation_ = db.operation_;
+		}
+		else if (type == SQLITE_TRACE_PROFILE && stmt == db.traced_stmt_ && db.trace_sink_ != nullptr) {
+			db.traced_stmt_ = nullptr;
+
+			trace_event event;
+			event.operation = db.traced_operation_;
+			event.nanoseconds = *static_cast<sqlite3_int64*>(x);
+			if (char* expanded = sqlite3_expanded_sql(stmt)) {
+				event.sql = expanded;
+				sqlite3_free(expanded);
+			}
+			db.trace_sink_->record(std::move(event));
+		}
+		return 0;
+	}
+
+	int sqlite::step_and_reset(sqlite3_stmt* stmt) {
 		if (stmt == nullptr) { return SQLITE_ERROR; }
 
-		// whether error or not we must call finalize
+		// whether error or not we must hand the statement back to the cache
 		int rc = sqlite3_step(stmt);
 		// SQLITE_ROW = another row ready - possible to configure to return a value - but we just ignore anything returned
 		// SQLITE_DONE = finished executing
 
 		// caller is more interested in the result of the step
-		int finalise_rc = sqlite3_finalize(stmt);  // de-allocates stmt
-		return rc == SQLITE_DONE ? finalise_rc : rc;
+		int reset_rc = statements_.release(stmt);  // resets stmt ready for reuse
+		return rc == SQLITE_DONE ? reset_rc : rc;
+	}
+
+	int sqlite::bind_value(sqlite3_stmt* stmt, int idx, const sqlite_data_type& value, sqlite3_destructor_type lifetime) {
+		// sizes are known so sqlite need not strlen text, 64 bit variants avoid any narrowing
+		switch (value.index()) {
+		case 0: return sqlite3_bind_int(stmt, idx, std::get<0>(value));
+		case 1: return sqlite3_bind_double(stmt, idx, std::get<1>(value));
+		case 2:
+			return sqlite3_bind_text64(stmt, idx, std::get<2>(value).data(),
+				std::get<2>(value).size(), lifetime, SQLITE_UTF8);
+		case 3:
+			return sqlite3_bind_blob64(stmt, idx, std::get<3>(value).data(),
+				std::get<3>(value).size(), lifetime);
+		case 4: return sqlite3_bind_int64(stmt, idx, std::get<4>(value));
+		case 5: return sqlite3_bind_null(stmt, idx);
+		case 6:
+			if (std::get<6>(value).size < 0) { return SQLITE_RANGE; }
+			return sqlite3_bind_zeroblob64(stmt, idx, static_cast<sqlite3_uint64>(std::get<6>(value).size));
+		case 7:
+			// a null pointer would bind NULL rather than an empty BLOB
+			if (std::get<7>(value).empty()) { return sqlite3_bind_zeroblob(stmt, idx, 0); }
+			return sqlite3_bind_blob64(stmt, idx, std::get<7>(value).data(), std::get<7>(value).size(), lifetime);
+		}
+		return SQLITE_OK;
+	}
+
+	int sqlite::execute(const std::string& sql) {
+		sqlite3_stmt* stmt = NULL;
+		EXIT_ON_ERROR(statements_.acquire(db_, sql, &stmt));
+
+		return step_and_reset(stmt);
+	}
+
+	transaction::~transaction() {
+		if (active_) {
+			rollback();
+		}
+	}
+
+	int transaction::begin(mode m) {
+		if (active_ || db_.db_ == nullptr) { return SQLITE_MISUSE; }
+		sqlite::operation_scope scope(db_, traced_operation::transaction);
+
+		int rc = SQLITE_OK;
+		if (sqlite3_get_autocommit(db_.db_) == 0) {
+			savepoint_ = ++db_.savepoint_depth_;
+			rc = db_.execute("SAVEPOINT " + savepoint_name() + ";");
+			if (rc != SQLITE_OK) {
+				--db_.savepoint_depth_;
+				savepoint_ = 0;
+			}
+		}
+		else {
+			switch (m) {
+			case mode::deferred: rc = db_.execute("BEGIN DEFERRED;"); break;
+			case mode::immediate: rc = db_.execute("BEGIN IMMEDIATE;"); break;
+			case mode::exclusive: rc = db_.execute("BEGIN EXCLUSIVE;"); break;
+			}
+		}
+
+		active_ = rc == SQLITE_OK;
+		return rc;
+	}
+
+	int transaction::commit() {
+		if (!active_) { return SQLITE_MISUSE; }
+		sqlite::operation_scope scope(db_, traced_operation::transaction);
+
+		// on failure, eg SQLITE_BUSY, the transaction stays open so commit can be retried
+		int rc = nested() ? db_.execute("RELEASE " + savepoint_name() + ";") : db_.execute("COMMIT;");
+		if (rc == SQLITE_OK) {
+			active_ = false;
+			if (nested()) {
+				--db_.savepoint_depth_;
+			}
+		}
+		return rc;
+	}
+
+	int transaction::rollback() {
+		if (!active_) { return SQLITE_MISUSE; }
+		active_ = false;
+		sqlite::operation_scope scope(db_, traced_operation::transaction);
+
+		if (!nested()) {
+			// sqlite may already have rolled back, eg after SQLITE_FULL
+			return sqlite3_get_autocommit(db_.db_) ? SQLITE_OK : db_.execute("ROLLBACK;");
+		}
+
+		--db_.savepoint_depth_;
+		// ROLLBACK TO leaves the savepoint on the stack so it has to be released as well
+		int rc = db_.execute("ROLLBACK TO " + savepoint_name() + ";");
+		int release_rc = db_.execute("RELEASE " + savepoint_name() + ";");
+		return rc == SQLITE_OK ? release_rc : rc;
 	}
 
 	std::string sqlite::space_if_required(const std::string& s) {
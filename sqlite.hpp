@@ -29,6 +29,8 @@ SOFTWARE.
 // #define PRINT_BLOB_AS_HEX
 
 #include "sqlite3.h"
+#include "schema.hpp"
+#include "trace.hpp"
 
 #include <string>
 #include <vector>
@@ -36,25 +38,69 @@ SOFTWARE.
 #include <cstdint>
 #include <iostream>
 #include <map>
-
+#include <list>
+#include <unordered_map>
+#include <iterator>
+#include <string_view>
+#include <type_traits>
+#include <optional>
+#include <memory_resource>
+
+// on error the statement is handed back to the cache, which resets it ready for reuse
 #define EXIT_ON_ERROR(resultcode) \
-if (resultcode != SQLITE_OK) \
-{ \
-    sqlite3_finalize(stmt); \
-    return resultcode; \
-}
+do { \
+    int rc_ = (resultcode); \
+    if (rc_ != SQLITE_OK) \
+    { \
+        statements_.release(stmt); \
+        return rc_; \
+    } \
+} while (0)
 
 namespace sql {
 
+	/* read only view of blob bytes owned by something else */
+	struct blob_view {
+		const uint8_t* bytes = nullptr;
+		size_t length = 0;
+
+		const uint8_t* data() const { return bytes; }
+		size_t size() const { return length; }
+		bool empty() const { return length == 0; }
+		const uint8_t* begin() const { return bytes; }
+		const uint8_t* end() const { return bytes + length; }
+	};
+
+	inline bool operator==(const blob_view& a, const blob_view& b) { return a.bytes == b.bytes && a.length == b.length; }
+	inline bool operator!=(const blob_view& a, const blob_view& b) { return !(a == b); }
+
+	/* BLOB of size bytes, all zero */
+	struct zeroblob {
+		int64_t size;
+	};
+	inline bool operator==(const zeroblob& a, const zeroblob& b) { return a.size == b.size; }
+	inline bool operator!=(const zeroblob& a, const zeroblob& b) { return a.size != b.size; }
+
 	/*
 	sqlite types can be: NULL, INTEGER, REAL, TEXT, BLOB
-	NULL: we don't support this type
-	INTEGER: int
+	NULL: std::monostate
+	INTEGER: int, or int64_t if the value does not fit in an int
 	REAL: double
 	TEXT: std::string
 	BLOB: std::vector<uint8_t>
+	zeroblob: bound only, a BLOB of size zero bytes to be filled in later through a blob_stream
+	blob_view: bound only, a BLOB bound in place with SQLITE_STATIC, without a copy. the bytes
+	must stay valid until the statement using them returns, eg a mapped_file
+	new alternatives are appended so existing index based code is unaffected
 	*/
-	using sqlite_data_type = std::variant<int, double, std::string, std::vector<uint8_t> >;
+	using sqlite_data_type = std::variant<int, double, std::string, std::vector<uint8_t>, int64_t, std::monostate, zeroblob, blob_view>;
+
+	/* result types whose every allocation comes from one std::pmr::memory_resource, eg a
+	request scoped std::pmr::monotonic_buffer_resource which frees a whole result in one go.
+	a value decodes as sqlite_data_type but TEXT is std::pmr::string, BLOB std::pmr::vector */
+	using pmr_data_type = std::variant<int, double, std::pmr::string, std::pmr::vector<uint8_t>, int64_t, std::monostate>;
+	using pmr_row = std::pmr::map<std::pmr::string, pmr_data_type>;
+	using pmr_rows = std::pmr::vector<pmr_row>;
 
 	struct column_values {
 		std::string column_name;
@@ -66,10 +112,379 @@ namespace sql {
 		sqlite_data_type column_value;
 	};
 
+	/* how sqlite::open(filename, options) opens the database and performance related settings
+	applied straight after opening. settings left empty keep the sqlite default.
+	see https://sqlite.org/c3ref/open.html and https://sqlite.org/pragma.html */
+	struct open_options {
+		enum class journal { delete_file, truncate, persist, memory, wal, off };
+		enum class sync { off, normal, full, extra };
+		enum class temp { default_store, file, memory };
+		enum class cache { default_cache, private_cache, shared_cache };
+
+		// sqlite3_open_v2 flags
+		bool read_only = false;                 // SQLITE_OPEN_READONLY, database must already exist
+		bool no_mutex = false;                  // SQLITE_OPEN_NOMUTEX, caller guarantees one thread at a time per connection
+		bool uri = false;                       // SQLITE_OPEN_URI, filename may be a file: URI
+		bool immutable = false;                 // database never changes, no locking or change detection. implies read_only
+		cache cache_mode = cache::default_cache;
+
+		std::optional<int> page_size;           // bytes, only takes effect on a new database or after VACUUM
+		std::optional<journal> journal_mode;
+		std::optional<sync> synchronous;
+		std::optional<int64_t> mmap_size;       // bytes of the file to memory map, 0 disables
+		std::optional<int> cache_size;          // pages if positive, KiB if negative
+		std::optional<temp> temp_store;
+		std::optional<int> busy_timeout_ms;
+
+		// per connection lookaside allocator for small objects, applied before anything else
+		// is allocated. both must be set, a slot_count of 0 disables lookaside
+		std::optional<int> lookaside_slot_size; // bytes per slot, rounded down to a multiple of 8
+		std::optional<int> lookaside_slot_count;
+
+		/* full fsync on every commit. survives power loss */
+		static open_options durable();
+		/* WAL with NORMAL sync, large page cache and in memory temp store. a power loss may lose
+		the last transactions but never corrupts the database */
+		static open_options high_throughput_ingest();
+		/* WAL so readers never block on the writer, large memory map and page cache */
+		static open_options read_mostly();
+	};
+
+	/* values read back from the connection after applying open_options, so the caller can
+	see what actually took effect. eg journal_mode stays "memory" for an in-memory database */
+	struct open_settings {
+		std::string journal_mode;
+		int synchronous = 0;        // 0 OFF, 1 NORMAL, 2 FULL, 3 EXTRA
+		int64_t mmap_size = 0;
+		int cache_size = 0;
+		int temp_store = 0;         // 0 DEFAULT, 1 FILE, 2 MEMORY
+		int page_size = 0;
+		int busy_timeout_ms = 0;
+	};
+
+	/* outcome of sqlite::insert_many */
+	struct insert_many_result {
+		size_t rows_inserted = 0;        // rows committed, or stepped if inside caller's transaction
+		size_t failed_row = 0;           // index of row that failed, only meaningful on error
+		std::string error_description;   // sqlite error text captured before any rollback
+	};
+
 	std::ostream& operator<< (std::ostream& os, const column_values& v);
 	std::ostream& operator<< (std::ostream& os, const sqlite_data_type& v);
+	std::ostream& operator<< (std::ostream& os, const zeroblob& v);
+	std::ostream& operator<< (std::ostream& os, const blob_view& v);
 	std::ostream& operator<< (std::ostream& os, const std::map<std::string, sqlite_data_type>& v);
 
+	/* names of the result columns of a prepared statement, empty string if sqlite has no name */
+	std::vector<std::string> get_column_names(sqlite3_stmt* stmt);
+
+	/* copy every column of the current result row of stmt into row, keyed by column_names */
+	void read_row(sqlite3_stmt* stmt, const std::vector<std::string>& column_names, std::map<std::string, sqlite_data_type>& row);
+
+	/* as read_row, allocating from the memory_resource of row */
+	void read_row(sqlite3_stmt* stmt, const std::pmr::vector<std::string_view>& column_names, pmr_row& row);
+
+	/* names of a prepared statement's parameters resolved once at prepare time, so binding
+	by name needs neither a string allocation nor sqlite3_bind_parameter_index */
+	struct parameter_slots {
+		// names[i] is parameter i + 1 without its : @ or $ prefix, empty for ? parameters
+		std::vector<std::string> names;
+
+		/* sqlite parameter index of name, or 0 if no such parameter. generated sql declares
+		parameters in the same order values are bound so hint, the expected index, is tried first */
+		int index_of(const std::string& name, int hint) const {
+			if (hint > 0 && static_cast<size_t>(hint) <= names.size() && names[hint - 1] == name) {
+				return hint;
+			}
+			for (size_t i = 0; i < names.size(); ++i) {
+				if (names[i] == name) { return static_cast<int>(i + 1); }
+			}
+			return 0;
+		}
+	};
+
+	/* bounded least recently used cache of prepared statements keyed by sql text.
+	statements are prepared with SQLITE_PREPARE_PERSISTENT and on release are reset
+	and have their bindings cleared so the next call generating the same sql can reuse them.
+	a statement still in use when the same sql is requested again is not shared, instead
+	a transient statement is prepared and finalised on release */
+	class statement_cache {
+	public:
+		explicit statement_cache(size_t capacity = 16);
+		~statement_cache();
+
+		statement_cache(const statement_cache&) = delete;
+		statement_cache& operator=(const statement_cache&) = delete;
+
+		/* get a ready to bind statement for sql, preparing one if not cached. if slots is
+		not null it receives the statement's parameter names, valid until release */
+		int acquire(sqlite3* db, const std::string& sql, sqlite3_stmt** stmt, const parameter_slots** slots = nullptr);
+
+		/* as acquire for sql of length characters which must be nul terminated at sql[length].
+		lets sql held in any string type be looked up without copying it to a std::string */
+		int acquire(sqlite3* db, const char* sql, size_t length, sqlite3_stmt** stmt, const parameter_slots** slots = nullptr);
+
+		/* as acquire for sql with static storage duration, eg generated at compile time.
+		looked up by address so no std::string is built per call */
+		int acquire_static(sqlite3* db, const char* sql, size_t length, sqlite3_stmt** stmt, const parameter_slots** slots = nullptr);
+
+		/* hand statement back to cache. returns result of sqlite3_reset, ie
+		the error code of the last step if it failed. nullptr is ignored */
+		int release(sqlite3_stmt* stmt);
+
+		/* finalise every cached statement. must be called before closing the connection */
+		void clear();
+
+		/* maximum number of statements kept. zero disables caching */
+		void set_capacity(size_t capacity);
+		size_t capacity() const { return capacity_; }
+		size_t size() const { return lru_.size(); }
+
+		uint64_t hits() const { return hits_; }
+		uint64_t misses() const { return misses_; }
+
+	private:
+		struct entry {
+			std::string sql;
+			const char* static_sql;   // key in static_index_, nullptr if keyed by sql
+			sqlite3_stmt* stmt;
+			bool in_use;
+			parameter_slots slots;
+		};
+
+		// most recently used at front
+		std::list<entry> lru_;
+		// statements not cached, finalised on release
+		std::list<entry> transient_;
+		// keys view the sql of their entry, list nodes never move
+		std::unordered_map<std::string_view, std::list<entry>::iterator> index_;
+		std::unordered_map<const char*, std::list<entry>::iterator> static_index_;
+		size_t capacity_;
+		uint64_t hits_;
+		uint64_t misses_;
+
+		void evict_to(size_t size);
+
+		// common to acquire and acquire_static. found is lru_.end() if sql not cached
+		int acquire_entry(sqlite3* db, const char* sql, size_t length, const char* static_sql,
+			std::list<entry>::iterator found, sqlite3_stmt** stmt, const parameter_slots** slots);
+	};
+
+	/* struct of arrays result set, an alternative to a vector of maps for wide or long scans.
+	each column holds contiguous arrays indexed by row. a typed array is only populated once a
+	cell of that type is seen in the column, so a column of one sqlite type costs one array.
+	text and blob cells are packed into one buffer per column with rows+1 offsets, cell r is
+	[offsets[r], offsets[r+1]). column names are stored once for the whole result */
+	class columnar_result {
+	public:
+		struct column {
+			std::vector<uint8_t> types;            // sqlite storage class per row, eg SQLITE_INTEGER
+			std::vector<uint64_t> null_bits;       // bit r set if row r is NULL
+			std::vector<int64_t> integers;         // SQLITE_INTEGER cells, empty if none
+			std::vector<double> reals;             // SQLITE_FLOAT cells, empty if none
+			std::vector<size_t> text_offsets;      // empty if no SQLITE_TEXT cells
+			std::string text;
+			std::vector<size_t> blob_offsets;      // empty if no SQLITE_BLOB cells
+			std::vector<uint8_t> blobs;
+		};
+
+		size_t rows() const { return rows_; }
+		size_t columns() const { return columns_.size(); }
+		const std::vector<std::string>& column_names() const { return column_names_; }
+
+		/* index of column named name, or columns() if no such column */
+		size_t column_index(const std::string& name) const;
+
+		const column& column_data(size_t col) const { return columns_[col]; }
+
+		/* sqlite storage class of cell */
+		int type(size_t col, size_t row) const { return columns_[col].types[row]; }
+		bool is_null(size_t col, size_t row) const {
+			return (columns_[col].null_bits[row / 64] >> (row % 64)) & 1u;
+		}
+
+		/* typed accessors. the value is only meaningful if type(col, row) matches */
+		int64_t get_int64(size_t col, size_t row) const;
+		double get_double(size_t col, size_t row) const;
+		std::string_view get_text(size_t col, size_t row) const;
+		blob_view get_blob(size_t col, size_t row) const;
+
+		/* discard all rows and columns */
+		void clear();
+
+	private:
+		friend class sqlite;
+
+		std::vector<std::string> column_names_;
+		std::vector<column> columns_;
+		size_t rows_ = 0;
+
+		void reset(std::vector<std::string> column_names);
+		void append_row(sqlite3_stmt* stmt);
+		// pad populated arrays so they all have one entry per row
+		void finish();
+	};
+
+	/* lightweight view of the current result row of a statement. text and blob values point
+	straight into sqlite memory and are only valid until the statement is next stepped, so
+	copy anything needed beyond the visitor call. columns are indexed from zero */
+	class row_view {
+	public:
+		explicit row_view(sqlite3_stmt* stmt) : stmt_(stmt) {}
+
+		int columns() const { return sqlite3_column_count(stmt_); }
+		const char* column_name(int col) const { return sqlite3_column_name(stmt_, col); }
+
+		/* index of column named name, or -1 if not found. no allocation */
+		int column_index(std::string_view name) const {
+			const int count = columns();
+			for (int i = 0; i < count; ++i) {
+				const char* colname = sqlite3_column_name(stmt_, i);
+				if (colname && name == colname) { return i; }
+			}
+			return -1;
+		}
+
+		/* sqlite storage class of column, eg SQLITE_INTEGER */
+		int type(int col) const { return sqlite3_column_type(stmt_, col); }
+		bool is_null(int col) const { return type(col) == SQLITE_NULL; }
+
+		int64_t get_int64(int col) const { return sqlite3_column_int64(stmt_, col); }
+		double get_double(int col) const { return sqlite3_column_double(stmt_, col); }
+
+		std::string_view get_text(int col) const {
+			// text must be fetched before its size, see sqlite3_column_bytes docs
+			const char* value = reinterpret_cast<const char*>(sqlite3_column_text(stmt_, col));
+			return value ? std::string_view(value, sqlite3_column_bytes(stmt_, col)) : std::string_view();
+		}
+
+		blob_view get_blob(int col) const {
+			const uint8_t* value = reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt_, col));
+			return blob_view{ value, value ? static_cast<size_t>(sqlite3_column_bytes(stmt_, col)) : 0u };
+		}
+
+	private:
+		sqlite3_stmt* stmt_;
+	};
+
+	/* forward only cursor over the rows of a SELECT. owns its statement and steps one row
+	at a time on demand, so only the current row is held in memory. usable in range-for and
+	standard algorithms through its input iterators. after iterating call status() which
+	returns SQLITE_DONE if all rows were read or the sqlite error code.
+	a cursor must be destroyed or closed before the sqlite connection which created it is closed */
+	class sqlite;
+
+	class cursor {
+	public:
+		using row_type = std::map<std::string, sqlite_data_type>;
+
+		class iterator {
+		public:
+			using iterator_category = std::input_iterator_tag;
+			using value_type = row_type;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const row_type*;
+			using reference = const row_type&;
+
+			iterator() : cursor_(nullptr) {}
+			explicit iterator(cursor* c) : cursor_(c) {}
+
+			reference operator*() const { return cursor_->row(); }
+			pointer operator->() const { return &cursor_->row(); }
+			iterator& operator++() { cursor_->next(); return *this; }
+			void operator++(int) { cursor_->next(); }
+
+			// an iterator is at the end once its cursor has no current row
+			bool operator==(const iterator& other) const { return at_end() == other.at_end(); }
+			bool operator!=(const iterator& other) const { return !(*this == other); }
+
+		private:
+			cursor* cursor_;
+			bool at_end() const { return cursor_ == nullptr || cursor_->status() != SQLITE_ROW; }
+		};
+
+		cursor();
+		~cursor();
+
+		cursor(cursor&& other) noexcept;
+		cursor& operator=(cursor&& other) noexcept;
+		cursor(const cursor&) = delete;
+		cursor& operator=(const cursor&) = delete;
+
+		/* steps to the first row if not yet started */
+		iterator begin();
+		iterator end() { return iterator(); }
+
+		/* step to the next row. returns SQLITE_ROW if a row is available, SQLITE_DONE when
+		there are no more rows, else the sqlite error code */
+		int next();
+
+		/* current row, only valid while status() is SQLITE_ROW */
+		const row_type& row() const { return row_; }
+
+		/* result of last step. SQLITE_OK if not yet stepped */
+		int status() const { return status_; }
+
+		const std::vector<std::string>& column_names() const { return column_names_; }
+
+		/* hand statement back to the connection. returns SQLITE_OK or the step error code */
+		int close();
+
+	private:
+		friend class sqlite;
+		cursor(sqlite* db, sqlite3_stmt* stmt, traced_operation operation);
+
+		sqlite* db_;
+		sqlite3_stmt* stmt_;
+		traced_operation operation_;   // reported for the steps taken after select_cursor returns
+		std::vector<std::string> column_names_;
+		row_type row_;
+		int status_;
+	};
+
+
+	/* incremental read and write of one BLOB value without copying the whole of it into memory,
+	see https://sqlite.org/c3ref/blob_open.html. the size of a BLOB can not be changed through a
+	stream so insert a zeroblob{size} first and then write the content in.
+	a stream must be closed before the sqlite connection which created it is closed */
+	class blob_stream {
+	public:
+		blob_stream() : blob_(nullptr) {}
+		~blob_stream() { close(); }
+
+		blob_stream(blob_stream&& other) noexcept;
+		blob_stream& operator=(blob_stream&& other) noexcept;
+		blob_stream(const blob_stream&) = delete;
+		blob_stream& operator=(const blob_stream&) = delete;
+
+		explicit operator bool() const { return blob_ != nullptr; }
+
+		/* size of the BLOB in bytes */
+		int size() const { return blob_ ? sqlite3_blob_bytes(blob_) : 0; }
+
+		/* read / write length bytes at offset. SQLITE_ERROR if the range is past the end */
+		int read(void* buffer, int length, int offset);
+		int write(const void* data, int length, int offset);
+
+		/* move to the same column of row rowid, cheaper than opening a new stream */
+		int reopen(int64_t rowid);
+
+		/* write the whole BLOB to out chunk_size bytes at a time */
+		int read_to(std::ostream& out, size_t chunk_size = 64 * 1024);
+
+		/* fill the BLOB from in chunk_size bytes at a time, starting at offset 0. a shorter input
+		leaves the rest of the BLOB unchanged, a longer one returns SQLITE_TOOBIG */
+		int write_from(std::istream& in, size_t chunk_size = 64 * 1024);
+
+		int close();
+
+	private:
+		friend class sqlite;
+		explicit blob_stream(sqlite3_blob* blob) : blob_(blob) {}
+
+		sqlite3_blob* blob_;
+	};
+
 
 	class sqlite {
 	public:
@@ -79,6 +494,17 @@ namespace sql {
 		/* database must be opened before calling an sql operation */
 		int open(const std::string& filename);
 
+		/* open database with sqlite3_open_v2 flags, eg SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX */
+		int open(const std::string& filename, int flags);
+
+		/* open database then apply the performance settings in options. applied receives the
+		settings read back from the connection. if applying a setting fails the database is
+		left open and the error code returned */
+		int open(const std::string& filename, const open_options& options, open_settings& applied);
+
+		/* same as above where caller is not interested in the settings applied */
+		int open(const std::string& filename, const open_options& options);
+
 		/* close database connection */
 		int close();
 
@@ -87,9 +513,34 @@ namespace sql {
 		template <typename columns_iterator>
 		int insert_into(const std::string& table_name, columns_iterator begin, columns_iterator end);
 
+		/* INSERT many rows reusing one prepared statement. rows_begin and end are iterators
+		to a collection of rows, each row a collection of column_values. every row must have the
+		same columns as the first row. rows are committed in transactions of rows_per_transaction
+		rows (zero means one transaction for all rows). If a transaction is already open on
+		this connection the rows join it instead. On error the current transaction is rolled back
+		and the rows processed stop. result reports rows committed and which row failed */
+		template <typename rows_iterator>
+		int insert_many(const std::string& table_name,
+			rows_iterator rows_begin,
+			rows_iterator rows_end,
+			insert_many_result& result,
+			size_t rows_per_transaction = 1000);
+
+		/* same as above where caller is not interested in the detail of the result */
+		template <typename rows_iterator>
+		int insert_many(const std::string& table_name,
+			rows_iterator rows_begin,
+			rows_iterator rows_end,
+			size_t rows_per_transaction = 1000);
+
+		/* open the BLOB in column of row rowid of table_name for incremental i/o through result.
+		writable false opens it read only */
+		int open_blob(const std::string& table_name, const std::string& column, int64_t rowid,
+			bool writable, blob_stream& result);
+
 		/* returns rowid of last successfully inserted row. If no rows
 		inserted since this database connectioned opened, returns zero. */
-		int last_insert_rowid();
+		int64_t last_insert_rowid();
 
 		/* UPDATE contacts SET col1 = value1, col2 = value2, ... WHERE rowid = therowid;
 		table_name is table to update,
@@ -155,15 +606,174 @@ namespace sql {
 			where_bindings_iterator where_bindings_end,
 			std::vector<std::map<std::string, sqlite_data_type>>& results);
 
+		/* as select_columns but results, its rows and values and the generated sql are all
+		allocated from results' memory_resource. a statement cache miss still copies the sql
+		into a std::string and a cache entry on the global heap. for example:
+			std::pmr::monotonic_buffer_resource arena;
+			sql::pmr_rows results(&arena);
+			db.select_columns("calls", cols.begin(), cols.end(), "", none.begin(), none.end(), results);
+		*/
+		template <typename column_names_iterator, typename where_bindings_iterator>
+		int select_columns(const std::string& table_name,
+			column_names_iterator name_begin,
+			column_names_iterator name_end,
+			const std::string& where_clause,
+			where_bindings_iterator where_bindings_begin,
+			where_bindings_iterator where_bindings_end,
+			pmr_rows& results);
+
+		/* SELECT col1, col2 FROM table_name WHERE col1 = x; returning a cursor which reads the
+		rows one at a time instead of materialising them all in a vector.
+		parameters as select_columns. on success result is a cursor positioned before the first row.
+		the where values are copied, so the bindings need not outlive this call. the cursor must
+		not outlive the connection */
+		template <typename column_names_iterator, typename where_bindings_iterator>
+		int select_cursor(const std::string& table_name,
+			column_names_iterator name_begin,
+			column_names_iterator name_end,
+			const std::string& where_clause,
+			where_bindings_iterator where_bindings_begin,
+			where_bindings_iterator where_bindings_end,
+			cursor& result);
+
+		/* SELECT col1, col2 FROM table_name WHERE col1 = x; into a column oriented result.
+		parameters as select_columns. results is cleared before reading */
+		template <typename column_names_iterator, typename where_bindings_iterator>
+		int select_columnar(const std::string& table_name,
+			column_names_iterator name_begin,
+			column_names_iterator name_end,
+			const std::string& where_clause,
+			where_bindings_iterator where_bindings_begin,
+			where_bindings_iterator where_bindings_end,
+			columnar_result& results);
+
+		/* SELECT col1, col2 FROM table_name WHERE col1 = x; calling visitor(const row_view&)
+		once per row instead of copying the rows into a results table. nothing is allocated per
+		row. if visitor returns bool, returning false stops the select early.
+		other parameters as select_columns */
+		template <typename column_names_iterator, typename where_bindings_iterator, typename row_visitor>
+		int select_for_each(const std::string& table_name,
+			column_names_iterator name_begin,
+			column_names_iterator name_end,
+			const std::string& where_clause,
+			where_bindings_iterator where_bindings_begin,
+			where_bindings_iterator where_bindings_end,
+			row_visitor&& visitor);
+
+		/* SELECT col1, col2 FROM table_name WHERE col1 = x; appending each row to results as a
+		std::tuple<Ts...>. columns are read by position straight into the tuple types, no
+		sqlite_data_type or map involved. the declared type of each result column is checked
+		against Ts once before stepping, returning SQLITE_MISMATCH if the number of columns differs
+		or a column cannot be read as its type. use std::optional<T> for nullable columns.
+		other parameters as select_columns */
+		template <typename... Ts, typename column_names_iterator, typename where_bindings_iterator>
+		int select_as(const std::string& table_name,
+			column_names_iterator name_begin,
+			column_names_iterator name_end,
+			const std::string& where_clause,
+			where_bindings_iterator where_bindings_begin,
+			where_bindings_iterator where_bindings_end,
+			std::vector<std::tuple<Ts...>>& results);
+
+		/* typed operations on a table described at compile time with sql::table, see schema.hpp.
+		the sql is generated at compile time and rows are addressed by rowid */
+
+		/* INSERT a row of the table's column types */
+		template <typename table>
+		int insert_row(const typename table::row_type& row);
+
+		/* UPDATE every column of the table in the row with rowid */
+		template <typename table>
+		int update_row(int64_t rowid, const typename table::row_type& row);
+
+		/* DELETE the row with rowid */
+		template <typename table>
+		int delete_row(int64_t rowid);
+
+		/* SELECT the row with rowid. returns SQLITE_OK if found, SQLITE_DONE if no such row */
+		template <typename table>
+		int select_row(int64_t rowid, typename table::row_type& row);
+
+		/* SELECT every row of the table, appended to rows */
+		template <typename table>
+		int select_rows(std::vector<typename table::row_type>& rows);
+
+		/* PRAGMA name = value; result receives the first column of the first row returned,
+		if any, for example the journal mode actually set by PRAGMA journal_mode = WAL; */
+		int pragma(const std::string& name, const std::string& value, std::string& result);
+
+		/* PRAGMA name; result receives the current value */
+		int pragma(const std::string& name, std::string& result);
+
 		/* get error text relating to last sqlite error. Call this function
 		whenever an operation returns a sqlite error code */
 		const std::string get_last_error_description();
 
+		/* abort any operation running on this connection. may be called from another thread,
+		the interrupted operation returns SQLITE_INTERRUPT */
+		void interrupt();
+
+		/* maximum number of prepared statements cached on this connection, default 16.
+		zero disables the cache so every call prepares and finalises its statement */
+		void set_statement_cache_capacity(size_t capacity);
+
+		/* number of sql operations which reused / had to prepare a statement */
+		uint64_t statement_cache_hits() const;
+		uint64_t statement_cache_misses() const;
+
+		/* report statements run on this connection to sink through sqlite3_trace_v2, see
+		trace.hpp. one statement in every sample_every is recorded with its expanded sql, wall
+		time and the wrapper operation which ran it, the others cost only sqlite's timing. a
+		statement starting while a sampled one is still running is not sampled. nullptr removes
+		the trace hook so an untraced connection pays nothing. sink must outlive the connection
+		or be removed first. close() removes it. call on the thread using the connection.
+		SQLITE_MISUSE if sample_every is 0 */
+		int set_trace(trace_sink* sink, uint32_t sample_every = 1);
+
 	private:
+		friend class cursor;
+		friend class transaction;
+		friend class snapshot_read;
+		friend class group_commit_writer;
+
 		sqlite3* db_;
+		statement_cache statements_;
+		int savepoint_depth_;
+
+		// the wrapper operation running now, and the sampled statement in flight
+		traced_operation operation_;
+		trace_sink* trace_sink_;
+		uint32_t trace_sample_every_;
+		uint32_t trace_countdown_;
+		sqlite3_stmt* traced_stmt_;
+		traced_operation traced_operation_;
+
+		/* attributes the statements run while it exists to op. an operation implemented with
+		another, eg select_star calling select_columns, keeps the outer one */
+		class operation_scope {
+		public:
+			operation_scope(sqlite& db, traced_operation op) : db_(db), previous_(db.operation_) {
+				if (previous_ == traced_operation::none) { db_.operation_ = op; }
+			}
+			~operation_scope() { db_.operation_ = previous_; }
+
+			operation_scope(const operation_scope&) = delete;
+			operation_scope& operator=(const operation_scope&) = delete;
+
+		private:
+			sqlite& db_;
+			traced_operation previous_;
+		};
+
+		static int trace_callback(unsigned type, void* context, void* p, void* x);
 
 		template <typename columns_iterator>
-		int bind_fields(sqlite3_stmt* stmt, columns_iterator begin, columns_iterator end);
+		int bind_fields(sqlite3_stmt* stmt, const parameter_slots& slots, columns_iterator begin, columns_iterator end);
+
+		/* text and blob values are bound with lifetime, SQLITE_STATIC by default so they are not
+		copied. SQLITE_STATIC values must outlive every step of the statement */
+		static int bind_value(sqlite3_stmt* stmt, int idx, const sqlite_data_type& value,
+			sqlite3_destructor_type lifetime = SQLITE_STATIC);
 
 		template <typename columns_iterator>
 		std::string  insert_into_helper(const std::string& table_name, columns_iterator begin, columns_iterator end);
@@ -175,10 +785,23 @@ namespace sql {
 			columns_iterator end,
 			const std::string& where_clause);
 
+		/* bind where parameters by name. first_index is where the first of them is expected in
+		the sql, eg after the SET parameters of an update, and only serves as a lookup hint.
+		lifetime as bind_value */
 		template <typename where_binding_iterator>
-		int bind_where(sqlite3_stmt* stmt, where_binding_iterator begin, where_binding_iterator end);
+		int bind_where(sqlite3_stmt* stmt, const parameter_slots& slots, where_binding_iterator begin, where_binding_iterator end,
+			int first_index = 1, sqlite3_destructor_type lifetime = SQLITE_STATIC);
+
+		int step_and_reset(sqlite3_stmt* stmt);
+
+		/* acquire statement for sql generated by schema.hpp table */
+		template <typename table, typename statement>
+		int acquire_table_sql(sqlite3_stmt** stmt) {
+			return statements_.acquire_static(db_, table::template sql<statement>(), table::template sql_length<statement>(), stmt);
+		}
 
-		int step_and_finalise(sqlite3_stmt* stmt);
+		/* prepare (cached), step and reset an sql statement without bindings, eg BEGIN; */
+		int execute(const std::string& sql);
 
 		std::string space_if_required(const std::string& s);
 
@@ -192,26 +815,60 @@ namespace sql {
 			column_names_iterator name_begin,
 			column_names_iterator name_end,
 			const std::string& where_clause);
+
+		/* append SELECT sql to any string type without building temporary strings */
+		template <typename string_type, typename column_names_iterator>
+		static void append_select_sql(string_type& sql,
+			const std::string& table_name,
+			column_names_iterator name_begin,
+			column_names_iterator name_end,
+			const std::string& where_clause);
+	};
+
+	/* RAII transaction. begin() starts a transaction, or a SAVEPOINT if one is already open
+	on the connection so guards can be nested. commit() makes the changes permanent, a guard
+	destroyed without a successful commit rolls its changes back. the BEGIN, COMMIT and
+	SAVEPOINT statements are reused from the connection's statement cache.
+	guards must be destroyed in the reverse order they began */
+	class transaction {
+	public:
+		/* DEFERRED takes locks on first use, IMMEDIATE takes the write lock at once so two
+		writers can not deadlock upgrading read locks, EXCLUSIVE also blocks readers outside WAL mode.
+		ignored for a nested savepoint */
+		enum class mode { deferred, immediate, exclusive };
+
+		explicit transaction(sqlite& db) : db_(db), savepoint_(0), active_(false) {}
+		~transaction();
+
+		transaction(const transaction&) = delete;
+		transaction& operator=(const transaction&) = delete;
+
+		int begin(mode m = mode::deferred);
+		int commit();
+		int rollback();
+
+		/* begun and not yet committed or rolled back */
+		bool active() const { return active_; }
+		/* true if this guard is a SAVEPOINT inside an outer transaction */
+		bool nested() const { return savepoint_ != 0; }
+
+	private:
+		sqlite& db_;
+		int savepoint_;    // savepoint number, 0 if this guard owns the outer transaction
+		bool active_;
+
+		std::string savepoint_name() const { return "sqlite_cpp_sp" + std::to_string(savepoint_); }
 	};
 
 	template <typename columns_iterator>
-	int sqlite::bind_fields(sqlite3_stmt* stmt, columns_iterator begin, columns_iterator end) {
+	int sqlite::bind_fields(sqlite3_stmt* stmt, const parameter_slots& slots, columns_iterator begin, columns_iterator end) {
 
 		int rc = SQLITE_OK;
+		int idx = 0;
 
-		for (auto it = begin; it != end; ++it) {
-			std::string next_param{ ':' + it->column_name };
-			int idx = sqlite3_bind_parameter_index(stmt, next_param.c_str());
-
-			switch (it->column_value.index()) {
-			case 0: rc = sqlite3_bind_int(stmt, idx, std::get<0>(it->column_value)); break;
-			case 1: rc = sqlite3_bind_double(stmt, idx, std::get<1>(it->column_value)); break;
-			case 2: rc = sqlite3_bind_text(stmt, idx, std::get<2>(it->column_value).c_str(), -1, SQLITE_STATIC); break;
-			case 3:
-				rc = sqlite3_bind_blob(stmt, idx, std::get<3>(it->column_value).data(), 
-					static_cast<int>(std::get<3>(it->column_value).size()), SQLITE_STATIC);
-				break;
-			}
+		for (auto it = begin; it != end && rc == SQLITE_OK; ++it) {
+			idx = slots.index_of(it->column_name, idx + 1);
+			rc = bind_value(stmt, idx, it->column_value);
 		}
 		return rc;
 	}
@@ -219,15 +876,108 @@ namespace sql {
 	template <typename columns_iterator>
 	int sqlite::insert_into(const std::string& table_name, columns_iterator begin, columns_iterator end) {
 		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::insert_into);
 
 		const std::string sql = insert_into_helper(table_name, begin, end);
 
 		sqlite3_stmt* stmt = NULL;
-		EXIT_ON_ERROR(sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, NULL));
+		const parameter_slots* slots = nullptr;
+		EXIT_ON_ERROR(statements_.acquire(db_, sql, &stmt, &slots));
+
+		EXIT_ON_ERROR(bind_fields(stmt, *slots, begin, end));
+
+		return step_and_reset(stmt);
+	}
+
+	template <typename rows_iterator>
+	int sqlite::insert_many(const std::string& table_name,
+		rows_iterator rows_begin,
+		rows_iterator rows_end,
+		insert_many_result& result,
+		size_t rows_per_transaction) {
+		result = insert_many_result{};
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::insert_many);
+		if (rows_begin == rows_end) { return SQLITE_OK; }
+
+		const std::string sql = insert_into_helper(table_name, std::begin(*rows_begin), std::end(*rows_begin));
+
+		sqlite3_stmt* stmt = NULL;
+		const parameter_slots* slots = nullptr;
+		EXIT_ON_ERROR(statements_.acquire(db_, sql, &stmt, &slots));
+
+		// if the caller already has a transaction open the rows just join it
+		const bool own_transaction = sqlite3_get_autocommit(db_) != 0;
+		bool in_transaction = false;
+		size_t chunk_start = 0;
+		size_t row_index = 0;
+		int rc = SQLITE_OK;
+
+		for (auto row = rows_begin; row != rows_end; ++row, ++row_index) {
+			if (own_transaction && !in_transaction) {
+				chunk_start = row_index;
+				if ((rc = execute("BEGIN;")) != SQLITE_OK) { break; }
+				in_transaction = true;
+			}
+
+			rc = bind_fields(stmt, *slots, std::begin(*row), std::end(*row));
+			if (rc == SQLITE_OK) {
+				rc = sqlite3_step(stmt);
+			}
+			// clear so a row with a missing column does not pick up the previous row's value
+			sqlite3_reset(stmt);
+			sqlite3_clear_bindings(stmt);
+
+			if (rc != SQLITE_DONE) {
+				rc = rc == SQLITE_OK ? SQLITE_ERROR : rc;
+				break;
+			}
+			rc = SQLITE_OK;
 
-		EXIT_ON_ERROR(bind_fields(stmt, begin, end));
+			if (!own_transaction) {
+				result.rows_inserted = row_index + 1;
+			}
+			else if (row_index + 1 - chunk_start == rows_per_transaction) {
+				if ((rc = execute("COMMIT;")) != SQLITE_OK) {
+					// nothing in this chunk is committed so report its first row
+					row_index = chunk_start;
+					break;
+				}
+				in_transaction = false;
+				result.rows_inserted = row_index + 1;
+			}
+		}
 
-		return step_and_finalise(stmt);
+		if (rc == SQLITE_OK && in_transaction) {
+			if ((rc = execute("COMMIT;")) == SQLITE_OK) {
+				result.rows_inserted = row_index;
+			}
+			else {
+				row_index = chunk_start;
+			}
+		}
+
+		statements_.release(stmt);
+
+		if (rc != SQLITE_OK) {
+			result.failed_row = row_index;
+			result.error_description = get_last_error_description();
+
+			// sqlite may already have rolled back, eg on SQLITE_FULL
+			if (in_transaction && sqlite3_get_autocommit(db_) == 0) {
+				execute("ROLLBACK;");
+			}
+		}
+		return rc;
+	}
+
+	template <typename rows_iterator>
+	int sqlite::insert_many(const std::string& table_name,
+		rows_iterator rows_begin,
+		rows_iterator rows_end,
+		size_t rows_per_transaction) {
+		insert_many_result result;
+		return insert_many(table_name, rows_begin, rows_end, result, rows_per_transaction);
 	}
 
 		template <typename columns_iterator, typename where_bindings_iterator>
@@ -239,17 +989,21 @@ namespace sql {
 			where_bindings_iterator where_bindings_begin,
 			where_bindings_iterator where_bindings_end) {
 		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::update);
 
 		const std::string sql = update_helper(table_name, columns_begin, columns_end, where_clause);
 
 		sqlite3_stmt* stmt = NULL;
-		EXIT_ON_ERROR(sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, NULL));
+		const parameter_slots* slots = nullptr;
+		EXIT_ON_ERROR(statements_.acquire(db_, sql, &stmt, &slots));
 
-		EXIT_ON_ERROR(bind_fields(stmt, columns_begin, columns_end));
+		EXIT_ON_ERROR(bind_fields(stmt, *slots, columns_begin, columns_end));
 
-		EXIT_ON_ERROR(bind_where(stmt, where_bindings_begin, where_bindings_end));
+		// the where parameters follow one SET parameter per column
+		const int first_where_index = static_cast<int>(std::distance(columns_begin, columns_end)) + 1;
+		EXIT_ON_ERROR(bind_where(stmt, *slots, where_bindings_begin, where_bindings_end, first_where_index));
 
-		return step_and_finalise(stmt);
+		return step_and_reset(stmt);
 	}
 
 	template <typename columns_iterator>
@@ -304,25 +1058,15 @@ namespace sql {
 	}
 
 	template <typename where_binding_iterator>
-	int sqlite::bind_where(sqlite3_stmt* stmt, where_binding_iterator begin, where_binding_iterator end) { //const std::vector<sql::where_binding>& binding) {
+	int sqlite::bind_where(sqlite3_stmt* stmt, const parameter_slots& slots, where_binding_iterator begin, where_binding_iterator end,
+		int first_index, sqlite3_destructor_type lifetime) {
 
 		int rc = SQLITE_OK;
+		int idx = first_index - 1;
 
-		for (auto param = begin; param != end; ++param) {
-
-			std::string next_param{ ':' + param->column_name };
-
-			int idx = sqlite3_bind_parameter_index(stmt, next_param.c_str());
-
-			switch (param->column_value.index()) {
-			case 0: rc = sqlite3_bind_int(stmt, idx, std::get<0>(param->column_value)); break;
-			case 1: rc = sqlite3_bind_double(stmt, idx, std::get<1>(param->column_value)); break;
-			case 2:  rc = sqlite3_bind_text(stmt, idx, std::get<2>(param->column_value).c_str(), -1, SQLITE_STATIC); break;
-			case 3:
-				rc = sqlite3_bind_blob(stmt, idx, std::get<3>(param->column_value).data(),
-					static_cast<int>(std::get<3>(param->column_value).size()), SQLITE_STATIC);
-				break;
-			}
+		for (auto param = begin; param != end && rc == SQLITE_OK; ++param) {
+			idx = slots.index_of(param->column_name, idx + 1);
+			rc = bind_value(stmt, idx, param->column_value, lifetime);
 		}
 		return rc;
 	}
@@ -336,66 +1080,268 @@ namespace sql {
 		where_bindings_iterator where_bindings_end,
 		std::vector<std::map<std::string, sqlite_data_type>>& results) {
 		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::select_columns);
 
 		const std::string sql = select_helper(table_name, name_begin, name_end, where_clause);
 
 		sqlite3_stmt* stmt = NULL;
-		EXIT_ON_ERROR(sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, NULL));
+		const parameter_slots* slots = nullptr;
+		EXIT_ON_ERROR(statements_.acquire(db_, sql, &stmt, &slots));
+
+		EXIT_ON_ERROR(bind_where(stmt, *slots, where_bindings_begin, where_bindings_end));
 
-		EXIT_ON_ERROR(bind_where(stmt, where_bindings_begin, where_bindings_end));
+		const std::vector<std::string> column_names = get_column_names(stmt);
+
+		int rc = 0;
+		while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+			std::map<std::string, sqlite_data_type> row;
+			read_row(stmt, column_names, row);
+			results.push_back(std::move(row));
+		}
 
-		int num_cols = sqlite3_column_count(stmt);
+		// reset reports the step error, if any
+		return statements_.release(stmt);
+	}
 
-		std::vector<std::string> column_names;
-		for (int i = 0; i < num_cols; i++) {
+	template <typename column_names_iterator, typename where_bindings_iterator>
+	int sqlite::select_columns(const std::string& table_name,
+		column_names_iterator name_begin,
+		column_names_iterator name_end,
+		const std::string& where_clause,
+		where_bindings_iterator where_bindings_begin,
+		where_bindings_iterator where_bindings_end,
+		pmr_rows& results) {
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::select_columns);
+
+		std::pmr::memory_resource* resource = results.get_allocator().resource();
+		std::pmr::string sql(resource);
+		append_select_sql(sql, table_name, name_begin, name_end, where_clause);
+
+		sqlite3_stmt* stmt = NULL;
+		const parameter_slots* slots = nullptr;
+		EXIT_ON_ERROR(statements_.acquire(db_, sql.c_str(), sql.size(), &stmt, &slots));
+
+		EXIT_ON_ERROR(bind_where(stmt, *slots, where_bindings_begin, where_bindings_end));
+
+		// names point into sqlite, valid as long as the statement
+		const int num_cols = sqlite3_column_count(stmt);
+		std::pmr::vector<std::string_view> column_names(resource);
+		column_names.reserve(num_cols);
+		for (int i = 0; i < num_cols; ++i) {
 			const char* colname = sqlite3_column_name(stmt, i);
 			column_names.push_back(colname ? colname : "");
 		}
 
 		int rc = 0;
-		while ((rc = sqlite3_step(stmt)) != SQLITE_DONE) {
-			std::map<std::string, sqlite_data_type> row;
-			for (int i = 0; i < num_cols; i++)
-			{
-				switch (sqlite3_column_type(stmt, i))
-				{
-				case SQLITE3_TEXT:
-				{
-					const unsigned char* value = sqlite3_column_text(stmt, i);
-					int len = sqlite3_column_bytes(stmt, i);
-					row[column_names[i]] = std::string(value, value + len);
-				}
-				break;
-				case SQLITE_INTEGER:
-				{
-					row[column_names[i]] = sqlite3_column_int(stmt, i);
-				}
-				break;
-				case SQLITE_FLOAT:
-				{
-					row[column_names[i]] = sqlite3_column_double(stmt, i);
-				}
-				break;
-				case SQLITE_BLOB:
-				{
-					const uint8_t* value = reinterpret_cast<const uint8_t*>(sqlite3_column_blob(stmt, i));
-					int len = sqlite3_column_bytes(stmt, i);
-					row[column_names[i]] = std::vector<uint8_t>(value, value + len);
-				}
-				break;
-				case SQLITE_NULL:
-				{
-					row[column_names[i]] = "null";
-				}
-				break;
-				default:
-					break;
-				}
+		while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+			// the row is constructed with the vector's memory_resource
+			read_row(stmt, column_names, results.emplace_back());
+		}
+
+		// reset reports the step error, if any
+		return statements_.release(stmt);
+	}
+
+	template <typename column_names_iterator, typename where_bindings_iterator>
+	int sqlite::select_cursor(const std::string& table_name,
+		column_names_iterator name_begin,
+		column_names_iterator name_end,
+		const std::string& where_clause,
+		where_bindings_iterator where_bindings_begin,
+		where_bindings_iterator where_bindings_end,
+		cursor& result) {
+		result = cursor();
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::select_cursor);
+
+		const std::string sql = select_helper(table_name, name_begin, name_end, where_clause);
+
+		sqlite3_stmt* stmt = NULL;
+		const parameter_slots* slots = nullptr;
+		EXIT_ON_ERROR(statements_.acquire(db_, sql, &stmt, &slots));
+
+		// the statement first steps after this returns, when the bindings may be gone, so
+		// sqlite keeps its own copy of text and blob values
+		EXIT_ON_ERROR(bind_where(stmt, *slots, where_bindings_begin, where_bindings_end, 1, SQLITE_TRANSIENT));
+
+		result = cursor(this, stmt, operation_);
+		return SQLITE_OK;
+	}
+
+	template <typename column_names_iterator, typename where_bindings_iterator>
+	int sqlite::select_columnar(const std::string& table_name,
+		column_names_iterator name_begin,
+		column_names_iterator name_end,
+		const std::string& where_clause,
+		where_bindings_iterator where_bindings_begin,
+		where_bindings_iterator where_bindings_end,
+		columnar_result& results) {
+		results.clear();
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::select_columnar);
+
+		const std::string sql = select_helper(table_name, name_begin, name_end, where_clause);
+
+		sqlite3_stmt* stmt = NULL;
+		const parameter_slots* slots = nullptr;
+		EXIT_ON_ERROR(statements_.acquire(db_, sql, &stmt, &slots));
+
+		EXIT_ON_ERROR(bind_where(stmt, *slots, where_bindings_begin, where_bindings_end));
+
+		results.reset(get_column_names(stmt));
+
+		int rc = 0;
+		while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+			results.append_row(stmt);
+		}
+		results.finish();
+
+		// reset reports the step error, if any
+		return statements_.release(stmt);
+	}
+
+	template <typename column_names_iterator, typename where_bindings_iterator, typename row_visitor>
+	int sqlite::select_for_each(const std::string& table_name,
+		column_names_iterator name_begin,
+		column_names_iterator name_end,
+		const std::string& where_clause,
+		where_bindings_iterator where_bindings_begin,
+		where_bindings_iterator where_bindings_end,
+		row_visitor&& visitor) {
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::select_for_each);
+
+		const std::string sql = select_helper(table_name, name_begin, name_end, where_clause);
+
+		sqlite3_stmt* stmt = NULL;
+		const parameter_slots* slots = nullptr;
+		EXIT_ON_ERROR(statements_.acquire(db_, sql, &stmt, &slots));
+
+		EXIT_ON_ERROR(bind_where(stmt, *slots, where_bindings_begin, where_bindings_end));
+
+		const row_view row(stmt);
+
+		int rc = 0;
+		while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+			if constexpr (std::is_same_v<decltype(visitor(row)), bool>) {
+				if (!visitor(row)) { break; }
+			}
+			else {
+				visitor(row);
 			}
-			results.push_back(row);
 		}
 
-		return sqlite3_finalize(stmt);
+		// reset reports the step error, if any
+		return statements_.release(stmt);
+	}
+
+	template <typename... Ts, typename column_names_iterator, typename where_bindings_iterator>
+	int sqlite::select_as(const std::string& table_name,
+		column_names_iterator name_begin,
+		column_names_iterator name_end,
+		const std::string& where_clause,
+		where_bindings_iterator where_bindings_begin,
+		where_bindings_iterator where_bindings_end,
+		std::vector<std::tuple<Ts...>>& results) {
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::select_as);
+
+		const std::string sql = select_helper(table_name, name_begin, name_end, where_clause);
+
+		sqlite3_stmt* stmt = NULL;
+		const parameter_slots* slots = nullptr;
+		EXIT_ON_ERROR(statements_.acquire(db_, sql, &stmt, &slots));
+
+		EXIT_ON_ERROR(check_column_types<Ts...>(stmt));
+
+		EXIT_ON_ERROR(bind_where(stmt, *slots, where_bindings_begin, where_bindings_end));
+
+		int rc = 0;
+		while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+			results.emplace_back();
+			read_tuple(stmt, results.back());
+		}
+
+		// reset reports the step error, if any
+		return statements_.release(stmt);
+	}
+
+	template <typename table>
+	int sqlite::insert_row(const typename table::row_type& row) {
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::insert_row);
+
+		sqlite3_stmt* stmt = NULL;
+		EXIT_ON_ERROR((acquire_table_sql<table, typename table::insert_sql>(&stmt)));
+
+		EXIT_ON_ERROR(bind_tuple(stmt, 1, row));
+
+		return step_and_reset(stmt);
+	}
+
+	template <typename table>
+	int sqlite::update_row(int64_t rowid, const typename table::row_type& row) {
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::update_row);
+
+		sqlite3_stmt* stmt = NULL;
+		EXIT_ON_ERROR((acquire_table_sql<table, typename table::update_sql>(&stmt)));
+
+		EXIT_ON_ERROR(bind_tuple(stmt, 1, row));
+
+		EXIT_ON_ERROR(sqlite3_bind_int64(stmt, static_cast<int>(table::column_count) + 1, rowid));
+
+		return step_and_reset(stmt);
+	}
+
+	template <typename table>
+	int sqlite::delete_row(int64_t rowid) {
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::delete_row);
+
+		sqlite3_stmt* stmt = NULL;
+		EXIT_ON_ERROR((acquire_table_sql<table, typename table::delete_sql>(&stmt)));
+
+		EXIT_ON_ERROR(sqlite3_bind_int64(stmt, 1, rowid));
+
+		return step_and_reset(stmt);
+	}
+
+	template <typename table>
+	int sqlite::select_row(int64_t rowid, typename table::row_type& row) {
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::select_row);
+
+		sqlite3_stmt* stmt = NULL;
+		EXIT_ON_ERROR((acquire_table_sql<table, typename table::select_sql>(&stmt)));
+
+		EXIT_ON_ERROR(sqlite3_bind_int64(stmt, 1, rowid));
+
+		int rc = sqlite3_step(stmt);
+		if (rc == SQLITE_ROW) {
+			read_tuple(stmt, row);
+		}
+
+		int reset_rc = statements_.release(stmt);
+		return rc == SQLITE_ROW ? SQLITE_OK : rc == SQLITE_DONE ? SQLITE_DONE : reset_rc;
+	}
+
+	template <typename table>
+	int sqlite::select_rows(std::vector<typename table::row_type>& rows) {
+		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::select_rows);
+
+		sqlite3_stmt* stmt = NULL;
+		EXIT_ON_ERROR((acquire_table_sql<table, typename table::select_all_sql>(&stmt)));
+
+		while (sqlite3_step(stmt) == SQLITE_ROW) {
+			rows.emplace_back();
+			read_tuple(stmt, rows.back());
+		}
+
+		// reset reports the step error, if any
+		return statements_.release(stmt);
 	}
 
 	template <typename column_names_iterator>
@@ -405,29 +1351,42 @@ namespace sql {
 		column_names_iterator name_end,
 		const std::string& where_clause) {
 
-		std::string sql{ "SELECT " };
+		std::string sql;
+		append_select_sql(sql, table_name, name_begin, name_end, where_clause);
+		return sql;
+	}
 
-		std::string separator{ "" };
+	template <typename string_type, typename column_names_iterator>
+	void sqlite::append_select_sql(string_type& sql,
+		const std::string& table_name,
+		column_names_iterator name_begin,
+		column_names_iterator name_end,
+		const std::string& where_clause) {
+
+		sql += "SELECT ";
 
 		for (auto field = name_begin; field != name_end; ++field) {
-			sql += separator + *field;
-			separator = ",";
+			if (field != name_begin) {
+				sql += ',';
+			}
+			sql += *field;
 		}
 
 		if (name_begin == name_end) {
-			sql += "*";
+			sql += '*';
 		}
 
-		sql += " FROM " + table_name;
+		sql += " FROM ";
+		sql.append(table_name.data(), table_name.size());
 
 		if (!where_clause.empty()) {
-			sql += space_if_required(where_clause);
-			sql += where_clause;
+			if (where_clause[0] != ' ') {
+				sql += ' ';
+			}
+			sql.append(where_clause.data(), where_clause.size());
 		}
 
-		sql += ";";
-
-		return sql;
+		sql += ';';
 	}
 
 
@@ -437,15 +1396,17 @@ namespace sql {
 		where_bindings_iterator where_bindings_begin,
 		where_bindings_iterator where_bindings_end) {
 		if (db_ == nullptr) { return SQLITE_ERROR; }
+		operation_scope scope(*this, traced_operation::delete_from);
 
 		const std::string sql = delete_from_helper(table_name, where_clause);
 
 		sqlite3_stmt* stmt = NULL;
-		EXIT_ON_ERROR(sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, NULL));
+		const parameter_slots* slots = nullptr;
+		EXIT_ON_ERROR(statements_.acquire(db_, sql, &stmt, &slots));
 
-		EXIT_ON_ERROR(bind_where(stmt, where_bindings_begin, where_bindings_end));
+		EXIT_ON_ERROR(bind_where(stmt, *slots, where_bindings_begin, where_bindings_end));
 
-		return step_and_finalise(stmt);
+		return step_and_reset(stmt);
 	}
 
 	template <typename where_bindings_iterator>
@@ -454,6 +1415,7 @@ namespace sql {
 		where_bindings_iterator where_bindings_begin,
 		where_bindings_iterator where_bindings_end,
 		std::vector<std::map<std::string, sqlite_data_type>>& results) {
+		operation_scope scope(*this, traced_operation::select_star);
 		std::string empty;
 		return select_columns(table_name, empty.begin(), empty.end(), where_clause, where_bindings_begin, where_bindings_end, results);
 	}
@@ -1,4 +1,14 @@
 #include "sqlite.hpp"
+#include "connection_pool.hpp"
+#include "async_executor.hpp"
+#include "coroutine.hpp"
+#include "group_commit.hpp"
+#include "snapshot.hpp"
+#include "parallel_scan.hpp"
+#include "mapped_file.hpp"
+#include "memory_config.hpp"
+#include "page_cache.hpp"
+#include "trace.hpp"
 
 #include "sqlite3.h" // required for db_initial_setup
 
@@ -10,6 +20,11 @@
 #include <cstdio>
 #include <filesystem>
 #include <algorithm>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <memory_resource>
+#include <stdexcept>
 
 #include "gtest/gtest.h"
 
@@ -17,6 +32,13 @@ using namespace sql;
 
 namespace {
 
+	namespace calls_columns {
+		SQLITE_COLUMN(callerid, std::string);
+		SQLITE_COLUMN(contactid, int64_t);
+	}
+	SQLITE_TABLE_NAME(calls);
+	using calls_table = sql::table<calls, calls_columns::callerid, calls_columns::contactid>;
+
 	void db_initial_setup() {
 
 		if (remove("contacts.db") != 0) {
@@ -413,6 +435,1228 @@ TEST_F(sqlite_cpp_tester, join_returning_data_from_two_tables_returns_correct_da
 	EXPECT_NE(std::get<2>(results[0]["timestamp"]), "");
 }
 
+TEST_F(sqlite_cpp_tester, repeated_insert_reuses_cached_statement) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	const std::vector<sql::column_values> fields{
+	{"callerid", "0775512345"},
+	{"contactid", 2}
+	};
+
+	for (int i = 0; i < 3; ++i) {
+		EXPECT_EQ(db.insert_into("calls", fields.begin(), fields.end()), SQLITE_OK);
+	}
+
+	EXPECT_EQ(db.statement_cache_misses(), 1u);
+	EXPECT_EQ(db.statement_cache_hits(), 2u);
+
+	std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+	EXPECT_EQ(db.select_star("calls", results), SQLITE_OK);
+	EXPECT_EQ(results.size(), 4u);
+
+	// cached statements must not stop the connection closing
+	EXPECT_EQ(db.close(), SQLITE_OK);
+}
+
+TEST_F(sqlite_cpp_tester, statement_cache_capacity_zero_prepares_every_call) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+	db.set_statement_cache_capacity(0);
+
+	const std::vector<sql::column_values> fields{
+	{"callerid", "0775512345"},
+	{"contactid", 2}
+	};
+
+	EXPECT_EQ(db.insert_into("calls", fields.begin(), fields.end()), SQLITE_OK);
+	EXPECT_EQ(db.insert_into("calls", fields.begin(), fields.end()), SQLITE_OK);
+
+	EXPECT_EQ(db.statement_cache_misses(), 2u);
+	EXPECT_EQ(db.statement_cache_hits(), 0u);
+	EXPECT_EQ(db.close(), SQLITE_OK);
+}
+
+TEST_F(sqlite_cpp_tester, pragmas_do_not_displace_cached_statements) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db", sql::open_options::high_throughput_ingest()), SQLITE_OK);
+	db.set_statement_cache_capacity(1);
+
+	const std::vector<sql::column_values> fields{
+	{"callerid", "0775512345"},
+	{"contactid", 2}
+	};
+
+	std::string result;
+	EXPECT_EQ(db.insert_into("calls", fields.begin(), fields.end()), SQLITE_OK);
+	EXPECT_EQ(db.pragma("cache_size", result), SQLITE_OK);
+	EXPECT_EQ(db.pragma("synchronous", "NORMAL", result), SQLITE_OK);
+	EXPECT_EQ(db.insert_into("calls", fields.begin(), fields.end()), SQLITE_OK);
+
+	// neither open's pragmas nor these went through the cache
+	EXPECT_EQ(db.statement_cache_misses(), 1u);
+	EXPECT_EQ(db.statement_cache_hits(), 1u);
+	EXPECT_EQ(db.close(), SQLITE_OK);
+}
+
+
+TEST_F(sqlite_cpp_tester, insert_many_inserts_every_row_across_transaction_chunks) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	std::vector<std::vector<sql::column_values>> rows;
+	for (int i = 0; i < 2500; ++i) {
+		rows.push_back({ {"callerid", "0775512345"}, {"contactid", i} });
+	}
+
+	sql::insert_many_result result;
+	EXPECT_EQ(db.insert_many("calls", rows.begin(), rows.end(), result, 1000), SQLITE_OK);
+	EXPECT_EQ(result.rows_inserted, 2500u);
+
+	// one prepare for all the rows
+	EXPECT_EQ(db.statement_cache_misses() - 2u /* BEGIN, COMMIT */, 1u);
+
+	std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+	EXPECT_EQ(db.select_star("calls", results), SQLITE_OK);
+	EXPECT_EQ(results.size(), 2501u);
+}
+
+TEST_F(sqlite_cpp_tester, insert_many_reports_first_failed_row_and_rolls_back_its_chunk) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	const std::vector<std::vector<sql::column_values>> rows{
+		{ {"callerid", "01"}, {"contactid", 1} },
+		{ {"callerid", "02"}, {"contactid", 2} },
+		{ {"callerid", "03"}, {"contactid", 3} },
+		{ {"callerid", "04"}, {"nosuchcolumn", 4} },
+		{ {"callerid", "05"}, {"contactid", 5} }
+	};
+
+	sql::insert_many_result result;
+	EXPECT_NE(db.insert_many("calls", rows.begin(), rows.end(), result, 2), SQLITE_OK);
+	EXPECT_EQ(result.rows_inserted, 2u);
+	EXPECT_EQ(result.failed_row, 3u);
+	EXPECT_FALSE(result.error_description.empty());
+
+	// row 3 was in the chunk rolled back with the failing row
+	std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+	EXPECT_EQ(db.select_star("calls", results), SQLITE_OK);
+	EXPECT_EQ(results.size(), 3u);
+}
+
+
+TEST_F(sqlite_cpp_tester, select_cursor_steps_rows_on_demand) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	std::vector<std::vector<sql::column_values>> rows;
+	for (int i = 0; i < 10; ++i) {
+		rows.push_back({ {"callerid", "0775512345"}, {"contactid", i} });
+	}
+	EXPECT_EQ(db.insert_many("calls", rows.begin(), rows.end()), SQLITE_OK);
+
+	const std::vector<std::string> cols{ "callerid", "contactid" };
+	const std::vector<where_binding> bindings{
+	   {"callerid", "0775512345"}
+	};
+
+	sql::cursor rows_cursor;
+	EXPECT_EQ(db.select_cursor("calls", cols.begin(), cols.end(), "WHERE callerid=:callerid",
+		bindings.begin(), bindings.end(), rows_cursor), SQLITE_OK);
+
+	int expected = 0;
+	for (const auto& row : rows_cursor) {
+		EXPECT_EQ(row.size(), 2u);
+		EXPECT_EQ(std::get<int>(row.at("contactid")), expected++);
+	}
+	EXPECT_EQ(expected, 10);
+	EXPECT_EQ(rows_cursor.status(), SQLITE_DONE);
+
+	// works with standard algorithms too
+	sql::cursor counting_cursor;
+	EXPECT_EQ(db.select_cursor("calls", cols.begin(), cols.end(), "",
+		bindings.end(), bindings.end(), counting_cursor), SQLITE_OK);
+	EXPECT_EQ(std::distance(counting_cursor.begin(), counting_cursor.end()), 11);
+
+	rows_cursor.close();
+	counting_cursor.close();
+	EXPECT_EQ(db.close(), SQLITE_OK);
+}
+
+
+TEST_F(sqlite_cpp_tester, select_cursor_keeps_where_values_after_bindings_are_gone) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	// long enough that the value lives on the heap rather than in the string itself
+	const std::string callerid(64, '7');
+	const std::vector<sql::column_values> call{ {"callerid", callerid}, {"contactid", 42} };
+	EXPECT_EQ(db.insert_into("calls", call.begin(), call.end()), SQLITE_OK);
+
+	const std::vector<std::string> cols{ "callerid", "contactid" };
+	sql::cursor rows_cursor;
+	{
+		// the bindings are destroyed before the statement first steps
+		const std::vector<where_binding> bindings{ {"callerid", callerid} };
+		EXPECT_EQ(db.select_cursor("calls", cols.begin(), cols.end(), "WHERE callerid=:callerid",
+			bindings.begin(), bindings.end(), rows_cursor), SQLITE_OK);
+	}
+	// likely to take the freed block, so a value bound without a copy would match nothing
+	const std::string reused(64, '0');
+
+	int found = 0;
+	for (const auto& row : rows_cursor) {
+		EXPECT_EQ(std::get<std::string>(row.at("callerid")), callerid);
+		EXPECT_EQ(std::get<int>(row.at("contactid")), 42);
+		++found;
+	}
+	EXPECT_EQ(found, 1);
+	EXPECT_EQ(rows_cursor.status(), SQLITE_DONE);
+	EXPECT_EQ(rows_cursor.close(), SQLITE_OK);
+	EXPECT_EQ(db.close(), SQLITE_OK);
+}
+
+
+TEST_F(sqlite_cpp_tester, select_columnar_returns_one_array_per_column) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	const std::vector<std::vector<sql::column_values>> rows{
+		{ {"callerid", "0775512345"}, {"contactid", 2} },
+		{ {"callerid", "0775512346"} }
+	};
+	EXPECT_EQ(db.insert_many("calls", rows.begin(), rows.end()), SQLITE_OK);
+
+	const std::vector<std::string> cols{ "callerid", "contactid" };
+	const std::vector<where_binding> bindings{};
+
+	sql::columnar_result results;
+	EXPECT_EQ(db.select_columnar("calls", cols.begin(), cols.end(), "",
+		bindings.begin(), bindings.end(), results), SQLITE_OK);
+
+	EXPECT_EQ(results.rows(), 3u);
+	EXPECT_EQ(results.columns(), 2u);
+
+	const size_t callerid = results.column_index("callerid");
+	const size_t contactid = results.column_index("contactid");
+	EXPECT_EQ(results.get_text(callerid, 0), "07788111222");
+	EXPECT_EQ(results.get_text(callerid, 1), "0775512345");
+	EXPECT_EQ(results.get_text(callerid, 2), "0775512346");
+
+	EXPECT_EQ(results.type(contactid, 1), SQLITE_INTEGER);
+	EXPECT_EQ(results.get_int64(contactid, 1), 2);
+	EXPECT_TRUE(results.is_null(contactid, 2));
+	EXPECT_FALSE(results.is_null(contactid, 0));
+
+	// integer only column has no text or float storage
+	EXPECT_EQ(results.column_data(contactid).integers.size(), 3u);
+	EXPECT_TRUE(results.column_data(contactid).text_offsets.empty());
+	EXPECT_TRUE(results.column_data(contactid).reals.empty());
+}
+
+
+TEST_F(sqlite_cpp_tester, select_for_each_visits_rows_without_copying) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	const std::vector<sql::column_values> fields{
+	{"callerid", "0775512345"},
+	{"contactid", 2}
+	};
+	EXPECT_EQ(db.insert_into("calls", fields.begin(), fields.end()), SQLITE_OK);
+
+	const std::vector<std::string> cols{ "callerid", "contactid" };
+	const std::vector<where_binding> bindings{};
+
+	std::vector<std::string> callerids;
+	int64_t contactid_total = 0;
+	EXPECT_EQ(db.select_for_each("calls", cols.begin(), cols.end(), "", bindings.begin(), bindings.end(),
+		[&](const sql::row_view& row) {
+			callerids.emplace_back(row.get_text(0));
+			contactid_total += row.get_int64(row.column_index("contactid"));
+		}), SQLITE_OK);
+
+	EXPECT_EQ(callerids, (std::vector<std::string>{ "07788111222", "0775512345" }));
+	EXPECT_EQ(contactid_total, 3);
+
+	// returning false stops after first row
+	int visited = 0;
+	EXPECT_EQ(db.select_for_each("calls", cols.begin(), cols.end(), "", bindings.begin(), bindings.end(),
+		[&](const sql::row_view&) { ++visited; return false; }), SQLITE_OK);
+	EXPECT_EQ(visited, 1);
+}
+
+
+TEST_F(sqlite_cpp_tester, where_bindings_in_different_order_to_parameters_bind_correctly) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	const std::vector<sql::column_values> fields{
+	{"timestamp", "2021-01-01 00:00:00"}
+	};
+
+	// bindings listed in the opposite order to their parameters in the where clause
+	const std::vector<where_binding> bindings{
+	   {"callerid", "07788111222"},
+	   {"contactid", 1}
+	};
+
+	EXPECT_EQ(db.update("calls", fields.begin(), fields.end(), "WHERE contactid=:contactid AND callerid=:callerid",
+		bindings.begin(), bindings.end()), SQLITE_OK);
+
+	std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+	EXPECT_EQ(db.select_star("calls", results), SQLITE_OK);
+	EXPECT_EQ(results.size(), 1u);
+	EXPECT_EQ(std::get<std::string>(results[0]["timestamp"]), "2021-01-01 00:00:00");
+
+	sql::parameter_slots slots{ { "name", "age" } };
+	EXPECT_EQ(slots.index_of("age", 2), 2);
+	EXPECT_EQ(slots.index_of("name", 2), 1);
+	EXPECT_EQ(slots.index_of("missing", 1), 0);
+}
+
+
+TEST_F(sqlite_cpp_tester, compile_time_table_generates_sql_and_typed_crud) {
+	static_assert(calls_table::parameter_index<calls_columns::contactid>() == 2, "contactid is 2nd parameter");
+	EXPECT_STREQ(calls_table::sql<calls_table::insert_sql>(), "INSERT INTO calls (callerid,contactid) VALUES (?,?);");
+	EXPECT_STREQ(calls_table::sql<calls_table::update_sql>(), "UPDATE calls SET callerid=?,contactid=? WHERE rowid=?;");
+	EXPECT_STREQ(calls_table::sql<calls_table::select_all_sql>(), "SELECT callerid,contactid FROM calls;");
+	EXPECT_STREQ(calls_table::sql<calls_table::delete_sql>(), "DELETE FROM calls WHERE rowid=?;");
+
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	EXPECT_EQ(db.insert_row<calls_table>({ "0775512345", 2 }), SQLITE_OK);
+	const int64_t rowid = db.last_insert_rowid();
+
+	calls_table::row_type row;
+	EXPECT_EQ(db.select_row<calls_table>(rowid, row), SQLITE_OK);
+	EXPECT_EQ(row, calls_table::row_type("0775512345", 2));
+
+	EXPECT_EQ(db.update_row<calls_table>(rowid, { "0775599999", 3 }), SQLITE_OK);
+
+	std::vector<calls_table::row_type> rows;
+	EXPECT_EQ(db.select_rows<calls_table>(rows), SQLITE_OK);
+	EXPECT_EQ(rows.size(), 2u);
+	EXPECT_EQ(rows[1], calls_table::row_type("0775599999", 3));
+
+	EXPECT_EQ(db.delete_row<calls_table>(rowid), SQLITE_OK);
+	EXPECT_EQ(db.select_row<calls_table>(rowid, row), SQLITE_DONE);
+
+	// second use of the same generated sql reuses the statement
+	EXPECT_EQ(db.insert_row<calls_table>({ "0775512345", 2 }), SQLITE_OK);
+	EXPECT_GE(db.statement_cache_hits(), 1u);
+}
+
+
+TEST_F(sqlite_cpp_tester, select_as_reads_rows_into_typed_tuples) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	const std::vector<sql::column_values> fields{
+	{"callerid", "0775512345"}
+	};
+	EXPECT_EQ(db.insert_into("calls", fields.begin(), fields.end()), SQLITE_OK);
+
+	const std::vector<std::string> cols{ "rowid", "callerid", "contactid", "timestamp" };
+	const std::vector<where_binding> bindings{};
+
+	std::vector<std::tuple<int64_t, std::string, std::optional<int64_t>, std::string>> rows;
+	EXPECT_EQ(db.select_as("calls", cols.begin(), cols.end(), "", bindings.begin(), bindings.end(), rows), SQLITE_OK);
+
+	EXPECT_EQ(rows.size(), 2u);
+	EXPECT_EQ(std::get<0>(rows[0]), 1);
+	EXPECT_EQ(std::get<1>(rows[0]), "07788111222");
+	EXPECT_EQ(std::get<2>(rows[0]), 1);
+	EXPECT_NE(std::get<3>(rows[0]), "");
+	EXPECT_FALSE(std::get<2>(rows[1]).has_value());
+
+	// callerid is declared TEXT so can not be read as an integer
+	std::vector<std::tuple<int64_t>> bad_rows;
+	const std::vector<std::string> callerid_col{ "callerid" };
+	EXPECT_EQ(db.select_as("calls", callerid_col.begin(), callerid_col.end(), "", bindings.begin(), bindings.end(), bad_rows), SQLITE_MISMATCH);
+	EXPECT_TRUE(bad_rows.empty());
+
+	EXPECT_EQ(sql::declared_affinity("VARCHAR(20)"), sql::affinity::text);
+	EXPECT_EQ(sql::declared_affinity("BigInt"), sql::affinity::integer);
+	EXPECT_EQ(sql::declared_affinity("DATETIME"), sql::affinity::numeric);
+}
+
+
+TEST_F(sqlite_cpp_tester, null_and_64_bit_integers_round_trip_through_sqlite_data_type) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	const int64_t big = 5000000000;
+	const std::vector<sql::column_values> fields{
+	{"callerid", std::monostate{}},
+	{"contactid", big}
+	};
+	EXPECT_EQ(db.insert_into("calls", fields.begin(), fields.end()), SQLITE_OK);
+
+	const int64_t lastrowid = db.last_insert_rowid();
+	const std::vector<where_binding> bindings{
+	   {"rowid", lastrowid}
+	};
+
+	std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+	EXPECT_EQ(db.select_star("calls", "WHERE rowid=:rowid", bindings.begin(), bindings.end(), results), SQLITE_OK);
+
+	EXPECT_EQ(results.size(), 1u);
+	EXPECT_TRUE(std::holds_alternative<std::monostate>(results[0]["callerid"]));
+	EXPECT_EQ(std::get<int64_t>(results[0]["contactid"]), big);
+
+	std::ostringstream os;
+	os << results[0]["callerid"];
+	EXPECT_EQ(os.str(), "null");
+}
+
+
+TEST_F(sqlite_cpp_tester, connection_pool_readers_run_in_parallel_with_writer) {
+	sql::connection_pool pool;
+	EXPECT_EQ(pool.open("contacts.db", 3), SQLITE_OK);
+
+	{
+		sql::connection_pool::lease writer;
+		EXPECT_EQ(pool.acquire_writer(writer, std::chrono::milliseconds(100)), SQLITE_OK);
+
+		const std::vector<sql::column_values> fields{
+		{"callerid", "0775512345"},
+		{"contactid", 2}
+		};
+		EXPECT_EQ(writer->insert_into("calls", fields.begin(), fields.end()), SQLITE_OK);
+	}
+
+	std::atomic<int> rows_seen{ 0 };
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 6; ++i) {
+		threads.emplace_back([&pool, &rows_seen] {
+			sql::connection_pool::lease reader;
+			if (pool.acquire_reader(reader, std::chrono::seconds(5)) != SQLITE_OK) { return; }
+
+			std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+			if (reader->select_star("calls", results) == SQLITE_OK) {
+				rows_seen += static_cast<int>(results.size());
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	EXPECT_EQ(rows_seen, 12);
+
+	// readers refuse writes
+	sql::connection_pool::lease reader1, reader2, reader3, reader4;
+	EXPECT_EQ(pool.acquire_reader(reader1, std::chrono::milliseconds(100)), SQLITE_OK);
+	EXPECT_EQ(reader1->delete_from("calls"), SQLITE_READONLY);
+
+	// all readers leased so the next waits then times out
+	EXPECT_EQ(pool.acquire_reader(reader2, std::chrono::milliseconds(100)), SQLITE_OK);
+	EXPECT_EQ(pool.acquire_reader(reader3, std::chrono::milliseconds(100)), SQLITE_OK);
+	EXPECT_EQ(pool.acquire_reader(reader4, std::chrono::milliseconds(10)), SQLITE_BUSY);
+	EXPECT_EQ(pool.close(), SQLITE_BUSY);
+
+	reader1.release();
+	reader2.release();
+	reader3.release();
+	EXPECT_EQ(pool.close(), SQLITE_OK);
+}
+
+
+TEST_F(sqlite_cpp_tester, connection_pool_destructor_waits_for_outstanding_leases) {
+	auto pool = std::make_unique<sql::connection_pool>();
+	EXPECT_EQ(pool->open("contacts.db", 1), SQLITE_OK);
+
+	std::promise<void> leased;
+	std::atomic<bool> giving_back(false);
+	std::thread holder([&pool, &leased, &giving_back] {
+		sql::connection_pool::lease reader;
+		EXPECT_EQ(pool->acquire_reader(reader, std::chrono::milliseconds(100)), SQLITE_OK);
+		leased.set_value();
+		// long enough for the pool to be destroyed meanwhile if its destructor did not wait
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		std::vector<std::map<std::string, sql::sqlite_data_type>> rows;
+		EXPECT_EQ(reader->select_star("calls", rows), SQLITE_OK);
+		giving_back = true;
+	});
+	leased.get_future().wait();
+
+	pool.reset();
+	EXPECT_TRUE(giving_back);
+	holder.join();
+}
+
+
+TEST_F(sqlite_cpp_tester, open_with_options_applies_and_reports_settings) {
+	sql::sqlite db;
+	sql::open_settings applied;
+	EXPECT_EQ(db.open("contacts.db", sql::open_options::high_throughput_ingest(), applied), SQLITE_OK);
+
+	EXPECT_EQ(applied.journal_mode, "wal");
+	EXPECT_EQ(applied.synchronous, 1);
+	EXPECT_EQ(applied.cache_size, -64 * 1024);
+	EXPECT_EQ(applied.temp_store, 2);
+	EXPECT_EQ(applied.busy_timeout_ms, 5000);
+	EXPECT_EQ(db.close(), SQLITE_OK);
+
+	// an in-memory database can not use WAL, the setting read back shows what happened
+	sql::open_options options;
+	options.journal_mode = sql::open_options::journal::wal;
+	options.synchronous = sql::open_options::sync::off;
+	EXPECT_EQ(db.open(":memory:", options, applied), SQLITE_OK);
+	EXPECT_EQ(applied.journal_mode, "memory");
+	EXPECT_EQ(applied.synchronous, 0);
+}
+
+
+TEST_F(sqlite_cpp_tester, open_read_only_and_immutable_refuse_writes) {
+	sql::sqlite db;
+	sql::open_options options;
+	options.read_only = true;
+	options.no_mutex = true;
+	EXPECT_EQ(db.open("contacts.db", options), SQLITE_OK);
+
+	std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+	EXPECT_EQ(db.select_star("calls", results), SQLITE_OK);
+	EXPECT_EQ(results.size(), 1u);
+	EXPECT_EQ(db.delete_from("calls"), SQLITE_READONLY);
+	EXPECT_EQ(db.close(), SQLITE_OK);
+
+	sql::open_options reference;
+	reference.immutable = true;
+	EXPECT_EQ(db.open("contacts.db", reference), SQLITE_OK);
+	results.clear();
+	EXPECT_EQ(db.select_star("contacts", results), SQLITE_OK);
+	EXPECT_EQ(results.size(), 1u);
+	EXPECT_EQ(db.delete_from("contacts"), SQLITE_READONLY);
+	EXPECT_EQ(db.close(), SQLITE_OK);
+
+	// raw sqlite3_open_v2 flags, read only open fails on a missing file
+	EXPECT_EQ(db.open("no_such_file.db", SQLITE_OPEN_READONLY), SQLITE_CANTOPEN);
+}
+
+
+TEST_F(sqlite_cpp_tester, transaction_commits_or_rolls_back_nested_savepoints) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	const std::vector<sql::column_values> contact{
+	{"name", "Minnie Mouse"}
+	};
+	const std::vector<sql::column_values> call{
+	{"callerid", "0775512345"},
+	{"contactid", 2}
+	};
+
+	{
+		sql::transaction outer(db);
+		EXPECT_EQ(outer.begin(sql::transaction::mode::immediate), SQLITE_OK);
+		EXPECT_EQ(db.insert_into("contacts", contact.begin(), contact.end()), SQLITE_OK);
+
+		{
+			sql::transaction inner(db);
+			EXPECT_EQ(inner.begin(), SQLITE_OK);
+			EXPECT_TRUE(inner.nested());
+			EXPECT_EQ(db.insert_into("calls", call.begin(), call.end()), SQLITE_OK);
+			// inner destroyed without commit, only the calls insert is undone
+		}
+
+		EXPECT_EQ(outer.commit(), SQLITE_OK);
+		EXPECT_FALSE(outer.active());
+	}
+
+	{
+		sql::transaction abandoned(db);
+		EXPECT_EQ(abandoned.begin(), SQLITE_OK);
+		EXPECT_EQ(db.insert_into("contacts", contact.begin(), contact.end()), SQLITE_OK);
+	}
+
+	std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+	EXPECT_EQ(db.select_star("contacts", results), SQLITE_OK);
+	EXPECT_EQ(results.size(), 2u);
+	results.clear();
+	EXPECT_EQ(db.select_star("calls", results), SQLITE_OK);
+	EXPECT_EQ(results.size(), 1u);
+
+	// second use of BEGIN IMMEDIATE reuses the cached statement
+	const uint64_t misses = db.statement_cache_misses();
+	sql::transaction again(db);
+	EXPECT_EQ(again.begin(sql::transaction::mode::immediate), SQLITE_OK);
+	EXPECT_EQ(again.commit(), SQLITE_OK);
+	EXPECT_EQ(db.statement_cache_misses(), misses);
+}
+
+
+TEST_F(sqlite_cpp_tester, async_executor_runs_operations_on_workers_and_returns_futures) {
+	sql::async_executor executor;
+	EXPECT_EQ(executor.open("contacts.db", 2, 16, sql::open_options::durable()), SQLITE_OK);
+
+	std::future<int> inserted = executor.insert_into("calls", { {"callerid", "0775512345"}, {"contactid", 2} });
+	EXPECT_EQ(inserted.get(), SQLITE_OK);
+
+	std::future<sql::select_result> selected = executor.select_columns("calls", { "callerid", "contactid" },
+		"WHERE contactid=:contactid", { {"contactid", 2} });
+	sql::select_result result = selected.get();
+	EXPECT_EQ(result.rc, SQLITE_OK);
+	EXPECT_EQ(result.rows.size(), 1u);
+
+	// a cancelled operation never runs
+	sql::cancellation_token token;
+	token.cancel();
+	EXPECT_EQ(executor.delete_from("calls", "", {}, token).get(), SQLITE_INTERRUPT);
+
+	EXPECT_EQ(executor.update("calls", { {"contactid", 3} }, "WHERE contactid=:old", { {"old", 2} }).get(), SQLITE_OK);
+
+	executor.close();
+	EXPECT_EQ(executor.insert_into("calls", { {"callerid", "0775512345"} }).get(), SQLITE_MISUSE);
+}
+
+TEST_F(sqlite_cpp_tester, async_executor_rejects_work_when_queue_full) {
+	sql::async_executor executor;
+	EXPECT_EQ(executor.open("contacts.db", 1, 1), SQLITE_OK);
+
+	// hold the only worker until released
+	std::promise<void> release_worker;
+	std::shared_future<void> released = release_worker.get_future().share();
+	std::promise<void> worker_started;
+	std::future<int> blocking = executor.submit([released, &worker_started](sql::sqlite&) {
+		worker_started.set_value();
+		released.wait();
+		return SQLITE_OK;
+	});
+	worker_started.get_future().wait();
+
+	std::future<int> queued = executor.submit([](sql::sqlite&) { return SQLITE_OK; });
+	std::future<int> rejected = executor.submit([](sql::sqlite&) { return SQLITE_OK; });
+	EXPECT_EQ(rejected.get(), SQLITE_BUSY);
+
+	release_worker.set_value();
+	EXPECT_EQ(blocking.get(), SQLITE_OK);
+	EXPECT_EQ(queued.get(), SQLITE_OK);
+}
+
+TEST_F(sqlite_cpp_tester, async_executor_shared_token_interrupts_every_running_operation) {
+	sql::async_executor executor;
+	EXPECT_EQ(executor.open("contacts.db", 0, 4), SQLITE_MISUSE);
+	EXPECT_EQ(executor.open("contacts.db", 2, 4), SQLITE_OK);
+
+	// long enough to still be running when cancelled, short enough to end if never interrupted
+	const std::vector<std::string> count{
+		"(WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x<20000000) SELECT count(*) FROM c)" };
+	std::atomic<int> started(0);
+	auto long_select = [&count, &started](sql::sqlite& db) {
+		++started;
+		std::vector<std::map<std::string, sql::sqlite_data_type>> rows;
+		const std::vector<sql::where_binding> none;
+		return db.select_columns("contacts", count.begin(), count.end(), "", none.begin(), none.end(), rows);
+	};
+
+	sql::cancellation_token token;
+	std::future<int> first = executor.submit(long_select, token);
+	std::future<int> second = executor.submit(long_select, token);
+	while (started < 2) {
+		std::this_thread::yield();
+	}
+
+	// an interrupt before a statement starts is lost, so keep cancelling until both stop
+	for (int i = 0; i < 500; ++i) {
+		token.cancel();
+		if (first.wait_for(std::chrono::milliseconds(10)) == std::future_status::ready &&
+			second.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
+			break;
+		}
+	}
+	EXPECT_EQ(first.get(), SQLITE_INTERRUPT);
+	EXPECT_EQ(second.get(), SQLITE_INTERRUPT);
+}
+
+TEST_F(sqlite_cpp_tester, async_executor_survives_operation_exceptions) {
+	sql::async_executor executor;
+	EXPECT_EQ(executor.open("contacts.db", 1, 4), SQLITE_OK);
+
+	sql::cancellation_token token;
+	std::future<int> thrown = executor.submit([](sql::sqlite&) -> int {
+		throw std::runtime_error("operation failed");
+	}, token);
+	EXPECT_THROW(thrown.get(), std::runtime_error);
+
+	// a job from post has no future, the worker drops its exception and carries on. the job no
+	// longer counts as running under token, so cancelling must leave the next operation alone
+	EXPECT_EQ(executor.post([](sql::sqlite*) { throw std::runtime_error("job failed"); }, token), SQLITE_OK);
+	const std::vector<std::string> count{
+		"(WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x+1 FROM c WHERE x<2000000) SELECT count(*) FROM c)" };
+	std::atomic<bool> started(false);
+	std::future<int> after = executor.submit([&count, &started](sql::sqlite& db) {
+		started = true;
+		std::vector<std::map<std::string, sql::sqlite_data_type>> rows;
+		const std::vector<sql::where_binding> none;
+		return db.select_columns("contacts", count.begin(), count.end(), "", none.begin(), none.end(), rows);
+	});
+	while (!started) {
+		std::this_thread::yield();
+	}
+	while (after.wait_for(std::chrono::milliseconds(1)) != std::future_status::ready) {
+		token.cancel();
+	}
+	EXPECT_EQ(after.get(), SQLITE_OK);
+}
+
+#if defined(__cpp_impl_coroutine)
+
+namespace {
+
+	// minimal eagerly started coroutine for driving the awaitables in tests
+	struct detached_task {
+		struct promise_type {
+			detached_task get_return_object() { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	};
+
+	detached_task insert_then_stream(sql::async_executor& executor, std::promise<std::vector<size_t>>& done) {
+		// gcc rejects braced string literal initialisers inside a coroutine body, so build them first
+		std::vector<sql::column_values> first_call{ {"callerid", std::string("0775512345")}, {"contactid", 2} };
+		std::vector<sql::column_values> second_call{ {"callerid", std::string("0775512346")}, {"contactid", 3} };
+		std::vector<sql::where_binding> by_contact{ {"contactid", 2} };
+
+		int rc = co_await sql::co_insert_into(executor, "calls", first_call);
+		EXPECT_EQ(rc, SQLITE_OK);
+		rc = co_await sql::co_insert_into(executor, "calls", second_call);
+		EXPECT_EQ(rc, SQLITE_OK);
+
+		sql::select_result selected = co_await sql::co_select_columns(executor, "calls", {}, "WHERE contactid=:contactid", by_contact);
+		EXPECT_EQ(selected.rc, SQLITE_OK);
+		EXPECT_EQ(selected.rows.size(), 1u);
+
+		std::vector<size_t> batch_sizes;
+		sql::row_batch_stream stream = sql::co_select_batches(executor, "calls", { "callerid" }, "", {}, 2);
+		while (co_await stream.next()) {
+			batch_sizes.push_back(stream.batch().size());
+		}
+		EXPECT_EQ(stream.status(), SQLITE_DONE);
+		done.set_value(batch_sizes);
+	}
+
+	detached_task await_throwing_operation(sql::async_executor& executor, std::promise<std::string>& done) {
+		sql::query_awaitable<int> failing(executor, [](sql::sqlite&) -> int {
+			throw std::runtime_error("operation failed");
+		}, [](int rc) { return rc; }, {}, sql::cancellation_token());
+		try {
+			co_await failing;
+			done.set_value("no exception");
+		}
+		catch (const std::runtime_error& e) {
+			done.set_value(e.what());
+		}
+	}
+}
+
+TEST_F(sqlite_cpp_tester, coroutine_awaits_queries_and_streams_row_batches) {
+	sql::async_executor executor;
+	EXPECT_EQ(executor.open("contacts.db", 2, 16), SQLITE_OK);
+
+	std::promise<std::vector<size_t>> done;
+	std::future<std::vector<size_t>> batch_sizes = done.get_future();
+	insert_then_stream(executor, done);
+
+	// the calls row from db_initial_setup plus the 2 inserted, in batches of 2
+	EXPECT_EQ(batch_sizes.get(), (std::vector<size_t>{ 2, 1 }));
+	executor.close();
+}
+
+TEST_F(sqlite_cpp_tester, coroutine_rethrows_operation_exception_from_co_await) {
+	sql::async_executor executor;
+	EXPECT_EQ(executor.open("contacts.db", 1, 4), SQLITE_OK);
+
+	std::promise<std::string> done;
+	std::future<std::string> message = done.get_future();
+	await_throwing_operation(executor, done);
+	EXPECT_EQ(message.get(), "operation failed");
+	executor.close();
+}
+
+#endif // __cpp_impl_coroutine
+
+TEST_F(sqlite_cpp_tester, group_commit_writer_shares_transactions_between_threads) {
+	sql::group_commit_writer writer;
+	EXPECT_EQ(writer.open("contacts.db", 64, 20000), SQLITE_OK);
+
+	const int threads = 4;
+	const int rows_per_thread = 50;
+	std::vector<std::thread> producers;
+	std::atomic<int> failures(0);
+	for (int t = 0; t < threads; ++t) {
+		producers.emplace_back([&writer, &failures, t] {
+			std::vector<std::future<int>> done;
+			for (int i = 0; i < rows_per_thread; ++i) {
+				done.push_back(writer.insert_into("calls", { {"callerid", "0775512345"}, {"contactid", t * rows_per_thread + i} }));
+			}
+			for (auto& f : done) {
+				if (f.get() != SQLITE_OK) { ++failures; }
+			}
+		});
+	}
+	for (auto& p : producers) {
+		p.join();
+	}
+	EXPECT_EQ(failures, 0);
+	EXPECT_GE(writer.batches_committed(), 1u);
+	EXPECT_LT(writer.batches_committed(), static_cast<uint64_t>(threads * rows_per_thread));
+
+	writer.close();
+	EXPECT_EQ(writer.insert_into("calls", { {"callerid", "0775512345"} }).get(), SQLITE_MISUSE);
+
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+	std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+	EXPECT_EQ(db.select_star("calls", results), SQLITE_OK);
+	EXPECT_EQ(results.size(), 1u + threads * rows_per_thread);
+}
+
+#if defined(SQLITE_ENABLE_SNAPSHOT)
+
+TEST_F(sqlite_cpp_tester, snapshot_gives_readers_the_same_point_in_time) {
+	sql::connection_pool pool;
+	EXPECT_EQ(pool.open("contacts.db", 2), SQLITE_OK);
+	{
+		sql::connection_pool::lease writer, first_reader, second_reader;
+		EXPECT_EQ(pool.acquire_writer(writer, std::chrono::milliseconds(100)), SQLITE_OK);
+		EXPECT_EQ(pool.acquire_reader(first_reader, std::chrono::milliseconds(100)), SQLITE_OK);
+		EXPECT_EQ(pool.acquire_reader(second_reader, std::chrono::milliseconds(100)), SQLITE_OK);
+
+		sql::snapshot_read first(*first_reader);
+		EXPECT_EQ(first.begin(), SQLITE_OK);
+		sql::snapshot at;
+		EXPECT_EQ(first.capture(at), SQLITE_OK);
+
+		// a write after the snapshot is not seen by a read begun at it
+		const std::vector<sql::column_values> call{ {"callerid", "0775512345"}, {"contactid", 2} };
+		EXPECT_EQ(writer->insert_into("calls", call.begin(), call.end()), SQLITE_OK);
+
+		sql::snapshot_read second(*second_reader);
+		EXPECT_EQ(second.begin(at), SQLITE_OK);
+		std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+		EXPECT_EQ(second_reader->select_star("calls", results), SQLITE_OK);
+		EXPECT_EQ(results.size(), 1u);
+		EXPECT_EQ(second.end(), SQLITE_OK);
+		EXPECT_EQ(first.end(), SQLITE_OK);
+
+		EXPECT_EQ(second_reader->select_star("calls", results), SQLITE_OK);
+		EXPECT_EQ(results.size(), 2u);
+	}
+	EXPECT_EQ(pool.close(), SQLITE_OK);
+}
+
+#endif // SQLITE_ENABLE_SNAPSHOT
+
+TEST_F(sqlite_cpp_tester, parallel_scan_splits_rowid_ranges_across_readers) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+	for (int i = 0; i < 99; ++i) {
+		const std::vector<sql::column_values> call{ {"callerid", "0775512345"}, {"contactid", i % 3} };
+		EXPECT_EQ(db.insert_into("calls", call.begin(), call.end()), SQLITE_OK);
+	}
+	EXPECT_EQ(db.close(), SQLITE_OK);
+
+	sql::connection_pool pool;
+	EXPECT_EQ(pool.open("contacts.db", 4), SQLITE_OK);
+
+	// one sink per partition, so no locking between workers
+	std::vector<size_t> rows_per_partition(4, 0);
+	sql::scan_report report;
+	EXPECT_EQ(sql::parallel_scan(pool, "calls", { "contactid" }, "WHERE contactid=:contactid", { {"contactid", 2} }, 4,
+		[&rows_per_partition](size_t partition, const sql::row_view& row) {
+		EXPECT_EQ(row.get_int64(0), 2);
+		++rows_per_partition[partition];
+		return true;
+	}, report), SQLITE_OK);
+
+	ASSERT_EQ(report.partitions.size(), 4u);
+	EXPECT_EQ(report.rows(), 33u);
+	EXPECT_EQ(rows_per_partition[0] + rows_per_partition[1] + rows_per_partition[2] + rows_per_partition[3], 33u);
+	EXPECT_EQ(report.partitions.front().first_rowid, 1);
+	EXPECT_EQ(report.partitions.back().last_rowid, 100);
+	EXPECT_GE(report.skew(), 1.0);
+
+	EXPECT_EQ(pool.close(), SQLITE_OK);
+}
+
+TEST_F(sqlite_cpp_tester, blob_stream_writes_into_zeroblob_and_reads_back_in_chunks) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	// calls has no BLOB column but sqlite stores a BLOB in any column
+	std::string content(300000, '\0');
+	for (size_t i = 0; i < content.size(); ++i) {
+		content[i] = static_cast<char>(i * 7);
+	}
+	const std::vector<sql::column_values> call{ {"callerid", sql::zeroblob{ static_cast<int64_t>(content.size()) }}, {"contactid", 9} };
+	EXPECT_EQ(db.insert_into("calls", call.begin(), call.end()), SQLITE_OK);
+	const int64_t rowid = db.last_insert_rowid();
+
+	sql::blob_stream blob;
+	EXPECT_EQ(db.open_blob("calls", "callerid", rowid, true, blob), SQLITE_OK);
+	EXPECT_EQ(blob.size(), static_cast<int>(content.size()));
+	std::istringstream in(content);
+	EXPECT_EQ(blob.write_from(in, 4096), SQLITE_OK);
+
+	// input longer than the BLOB does not fit
+	std::istringstream too_long(content + "x");
+	EXPECT_EQ(blob.write_from(too_long, 4096), SQLITE_TOOBIG);
+	EXPECT_EQ(blob.close(), SQLITE_OK);
+
+	EXPECT_EQ(db.open_blob("calls", "callerid", rowid, false, blob), SQLITE_OK);
+	std::ostringstream out;
+	EXPECT_EQ(blob.read_to(out, 1000), SQLITE_OK);
+	EXPECT_TRUE(out.str() == content);
+
+	char byte = 0;
+	EXPECT_EQ(blob.write(&byte, 1, 0), SQLITE_READONLY);
+	blob.close();
+	EXPECT_EQ(db.close(), SQLITE_OK);
+}
+
+TEST_F(sqlite_cpp_tester, mapped_file_binds_blob_without_copy) {
+	const std::string content(100000, 'm');
+	{
+		std::ofstream file("mapped_blob.bin", std::ios::binary);
+		file << content;
+	}
+
+	sql::mapped_file mapped;
+	EXPECT_EQ(mapped.open("mapped_blob.bin"), SQLITE_OK);
+	EXPECT_EQ(mapped.size(), content.size());
+	EXPECT_EQ(mapped.open("no_such_file.bin"), SQLITE_CANTOPEN);
+	EXPECT_EQ(mapped.open("mapped_blob.bin"), SQLITE_OK);
+
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+	const std::vector<sql::column_values> call{ {"callerid", mapped.view()}, {"contactid", 10} };
+	EXPECT_EQ(db.insert_into("calls", call.begin(), call.end()), SQLITE_OK);
+	mapped.close();
+
+	std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+	const std::vector<std::string> columns{ "callerid" };
+	const std::vector<sql::where_binding> bindings{ {"contactid", 10} };
+	EXPECT_EQ(db.select_columns("calls", columns.begin(), columns.end(), "WHERE contactid=:contactid", bindings.begin(), bindings.end(), results), SQLITE_OK);
+	ASSERT_EQ(results.size(), 1u);
+	const std::vector<uint8_t>& stored = std::get<std::vector<uint8_t>>(results[0]["callerid"]);
+	EXPECT_TRUE(std::equal(stored.begin(), stored.end(), content.begin(), content.end()));
+
+	EXPECT_EQ(db.close(), SQLITE_OK);
+	remove("mapped_blob.bin");
+}
+
+TEST_F(sqlite_cpp_tester, select_columns_allocates_results_from_memory_resource) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	// stray pmr allocations outside the arena would throw. the default is put back however
+	// the test leaves, as a failed ASSERT returns early and later tests rely on it
+	struct default_resource_guard {
+		std::pmr::memory_resource* previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+		~default_resource_guard() { std::pmr::set_default_resource(previous); }
+	} guard;
+	std::pmr::monotonic_buffer_resource arena(64 * 1024, std::pmr::new_delete_resource());
+	{
+		sql::pmr_rows results(&arena);
+		const std::vector<std::string> columns{ "callerid", "contactid", "timestamp" };
+		const std::vector<sql::where_binding> bindings{ {"contactid", 1} };
+		EXPECT_EQ(db.select_columns("calls", columns.begin(), columns.end(), "WHERE contactid=:contactid",
+			bindings.begin(), bindings.end(), results), SQLITE_OK);
+
+		ASSERT_EQ(results.size(), 1u);
+		const std::pmr::string& callerid = std::get<std::pmr::string>(results[0]["callerid"]);
+		EXPECT_EQ(callerid, "07788111222");
+		EXPECT_EQ(callerid.get_allocator().resource(), &arena);
+		EXPECT_EQ(std::get<int>(results[0]["contactid"]), 1);
+	}
+	arena.release();
+	EXPECT_EQ(db.close(), SQLITE_OK);
+}
+
+TEST_F(sqlite_cpp_tester, configure_memory_installs_pool_allocator_before_initialise) {
+	// configuration is only accepted while sqlite is not initialised
+	ASSERT_EQ(sqlite3_shutdown(), SQLITE_OK);
+
+	sql::memory_options options;
+	options.pool_allocator = true;
+	options.memory_status = false;
+	options.lookaside_slot_size = 128;
+	options.lookaside_slot_count = 64;
+	EXPECT_EQ(sql::configure_memory(options), SQLITE_OK);
+
+	const uint64_t malloc_calls_before = sql::get_pool_statistics().malloc_calls;
+	{
+		sql::sqlite db;
+		sql::open_options connection;
+		connection.lookaside_slot_size = 256;
+		connection.lookaside_slot_count = 32;
+		EXPECT_EQ(db.open("contacts.db", connection), SQLITE_OK);
+		const std::vector<sql::column_values> call{ {"callerid", "0775512345"}, {"contactid", 4} };
+		EXPECT_EQ(db.insert_into("calls", call.begin(), call.end()), SQLITE_OK);
+		std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+		EXPECT_EQ(db.select_star("calls", results), SQLITE_OK);
+		EXPECT_EQ(results.size(), 2u);
+
+		// sqlite is now initialised
+		EXPECT_EQ(sql::configure_memory(options), SQLITE_MISUSE);
+		EXPECT_EQ(db.close(), SQLITE_OK);
+	}
+	EXPECT_GT(sql::get_pool_statistics().malloc_calls, malloc_calls_before);
+
+	// put the default allocator back for the other tests
+	ASSERT_EQ(sqlite3_shutdown(), SQLITE_OK);
+	sql::memory_options defaults;
+	defaults.memory_status = true;
+	EXPECT_EQ(sql::configure_memory(defaults), SQLITE_OK);
+}
+
+TEST_F(sqlite_cpp_tester, page_cache_shares_one_budget_between_connections) {
+	ASSERT_EQ(sqlite3_shutdown(), SQLITE_OK);
+
+	sql::page_cache_options options;
+	options.shards = 4;
+	options.max_pages = 40;
+	EXPECT_EQ(sql::configure_page_cache(options), SQLITE_OK);
+	{
+		sql::sqlite writer, reader;
+		EXPECT_EQ(writer.open("contacts.db"), SQLITE_OK);
+		EXPECT_EQ(reader.open("contacts.db"), SQLITE_OK);
+
+		// enough rows for the table to outgrow the budget
+		std::vector<std::vector<sql::column_values>> rows;
+		for (int i = 0; i < 2000; ++i) {
+			rows.push_back({ {"callerid", std::string(200, 'a' + i % 26)}, {"contactid", i} });
+		}
+		EXPECT_EQ(writer.insert_many("calls", rows.begin(), rows.end()), SQLITE_OK);
+
+		std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+		EXPECT_EQ(reader.select_star("calls", results), SQLITE_OK);
+		EXPECT_EQ(results.size(), 2001u);
+		results.clear();
+		EXPECT_EQ(writer.select_star("calls", results), SQLITE_OK);
+		EXPECT_EQ(results.size(), 2001u);
+
+		std::string integrity;
+		EXPECT_EQ(reader.pragma("integrity_check", integrity), SQLITE_OK);
+		EXPECT_EQ(integrity, "ok");
+
+		const sql::page_cache_statistics statistics = sql::get_page_cache_statistics();
+		EXPECT_GT(statistics.hits, 0u);
+		EXPECT_GT(statistics.misses, 0u);
+		EXPECT_GT(statistics.evictions, 0u);
+		EXPECT_LE(statistics.pages, 60u);
+
+		EXPECT_EQ(reader.close(), SQLITE_OK);
+		EXPECT_EQ(writer.close(), SQLITE_OK);
+	}
+
+	// put the default page cache back for the other tests
+	ASSERT_EQ(sqlite3_shutdown(), SQLITE_OK);
+	options.enabled = false;
+	EXPECT_EQ(sql::configure_page_cache(options), SQLITE_OK);
+}
+
+TEST_F(sqlite_cpp_tester, page_cache_keeps_each_connection_within_its_cache_size) {
+	ASSERT_EQ(sqlite3_shutdown(), SQLITE_OK);
+
+	sql::page_cache_options options;
+	options.shards = 4;
+	EXPECT_EQ(sql::configure_page_cache(options), SQLITE_OK);
+	{
+		sql::sqlite writer;
+		EXPECT_EQ(writer.open("contacts.db"), SQLITE_OK);
+		std::vector<std::vector<sql::column_values>> rows;
+		for (int i = 0; i < 2000; ++i) {
+			rows.push_back({ {"callerid", std::string(1000, 'a' + i % 26)}, {"contactid", i} });
+		}
+		EXPECT_EQ(writer.insert_many("calls", rows.begin(), rows.end()), SQLITE_OK);
+		EXPECT_EQ(writer.close(), SQLITE_OK);
+	}
+
+	// raw connections so sqlite3_db_status can report the pages each one holds
+	sqlite3* small_cache = nullptr;
+	sqlite3* large_cache = nullptr;
+	EXPECT_EQ(sqlite3_open("contacts.db", &small_cache), SQLITE_OK);
+	EXPECT_EQ(sqlite3_open("contacts.db", &large_cache), SQLITE_OK);
+	EXPECT_EQ(sqlite3_exec(small_cache, "PRAGMA cache_size=20;", nullptr, nullptr, nullptr), SQLITE_OK);
+	EXPECT_EQ(sqlite3_exec(large_cache, "PRAGMA cache_size=2000;", nullptr, nullptr, nullptr), SQLITE_OK);
+
+	auto pages_held = [](sqlite3* db) {
+		int used = 0, highwater = 0;
+		sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_USED, &used, &highwater, 0);
+		// bytes include per page headers, so this over counts by a few percent
+		return used / 4096;
+	};
+	auto read_all = [](sqlite3* db) {
+		sqlite3_stmt* stmt = nullptr;
+		EXPECT_EQ(sqlite3_prepare_v2(db, "SELECT * FROM calls;", -1, &stmt, nullptr), SQLITE_OK);
+		while (sqlite3_step(stmt) == SQLITE_ROW) {}
+		sqlite3_finalize(stmt);
+	};
+
+	// stay in one read transaction each so the cached pages remain valid
+	EXPECT_EQ(sqlite3_exec(large_cache, "BEGIN;", nullptr, nullptr, nullptr), SQLITE_OK);
+	EXPECT_EQ(sqlite3_exec(small_cache, "BEGIN;", nullptr, nullptr, nullptr), SQLITE_OK);
+	read_all(large_cache);
+	const int large_before = pages_held(large_cache);
+	EXPECT_GT(large_before, 400);
+
+	for (int i = 0; i < 3; ++i) {
+		read_all(small_cache);
+	}
+	EXPECT_LE(pages_held(small_cache), 25);
+	EXPECT_GE(pages_held(large_cache), large_before - 5);
+
+	sqlite3_exec(small_cache, "COMMIT;", nullptr, nullptr, nullptr);
+	sqlite3_exec(large_cache, "COMMIT;", nullptr, nullptr, nullptr);
+	EXPECT_EQ(sqlite3_close(small_cache), SQLITE_OK);
+	EXPECT_EQ(sqlite3_close(large_cache), SQLITE_OK);
+
+	ASSERT_EQ(sqlite3_shutdown(), SQLITE_OK);
+	options.enabled = false;
+	EXPECT_EQ(sql::configure_page_cache(options), SQLITE_OK);
+}
+
+TEST_F(sqlite_cpp_tester, trace_reports_expanded_sql_time_and_wrapper_operation) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	sql::trace_buffer events(16);
+	EXPECT_EQ(db.set_trace(&events, 0), SQLITE_MISUSE);
+	EXPECT_EQ(db.set_trace(&events), SQLITE_OK);
+
+	const std::vector<sql::column_values> fields{ {"name", "Mickey Mouse"}, {"company", "Disney"} };
+	EXPECT_EQ(db.insert_into("contacts", fields.begin(), fields.end()), SQLITE_OK);
+
+	const std::vector<sql::where_binding> bindings{ {"name", "Mickey Mouse"} };
+	std::vector<std::map<std::string, sql::sqlite_data_type>> results;
+	EXPECT_EQ(db.select_star("contacts", "WHERE name=:name", bindings.begin(), bindings.end(), results), SQLITE_OK);
+	EXPECT_EQ(results.size(), 1u);
+
+	sql::trace_event event;
+	ASSERT_TRUE(events.pop(event));
+	EXPECT_EQ(event.operation, sql::traced_operation::insert_into);
+	EXPECT_STREQ(sql::operation_name(event.operation), "insert_into");
+	EXPECT_NE(event.sql.find("'Mickey Mouse'"), std::string::npos);
+	EXPECT_GE(event.nanoseconds, 0);
+
+	// select_star is implemented with select_columns, the outer operation is reported
+	ASSERT_TRUE(events.pop(event));
+	EXPECT_EQ(event.operation, sql::traced_operation::select_star);
+	EXPECT_EQ(event.sql, "SELECT * FROM contacts WHERE name='Mickey Mouse';");
+	EXPECT_FALSE(events.pop(event));
+
+	// removing the sink stops tracing
+	EXPECT_EQ(db.set_trace(nullptr), SQLITE_OK);
+	EXPECT_EQ(db.delete_from("contacts"), SQLITE_OK);
+	EXPECT_FALSE(events.pop(event));
+	EXPECT_EQ(events.dropped(), 0u);
+}
+
+TEST_F(sqlite_cpp_tester, trace_attributes_cursor_steps_and_keeps_running_sample) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+	for (int i = 0; i < 3; ++i) {
+		const std::vector<sql::column_values> fields{ {"name", "contact " + std::to_string(i)} };
+		EXPECT_EQ(db.insert_into("contacts", fields.begin(), fields.end()), SQLITE_OK);
+	}
+
+	sql::trace_buffer events(16);
+	EXPECT_EQ(db.set_trace(&events), SQLITE_OK);
+
+	// the cursor's statement only starts running on its first step
+	const std::vector<std::string> cols{ "name" };
+	const std::vector<sql::where_binding> none;
+	{
+		sql::cursor rows;
+		EXPECT_EQ(db.select_cursor("contacts", cols.begin(), cols.end(), "", none.begin(), none.end(), rows), SQLITE_OK);
+		size_t count = 0;
+		for (const auto& row : rows) {
+			(void)row;
+			++count;
+		}
+		// and the contact added by db_initial_setup
+		EXPECT_EQ(count, 4u);
+	}
+
+	sql::trace_event event;
+	ASSERT_TRUE(events.pop(event));
+	EXPECT_EQ(event.operation, sql::traced_operation::select_cursor);
+	EXPECT_EQ(event.sql, "SELECT name FROM contacts;");
+	EXPECT_FALSE(events.pop(event));
+
+	// statements run by the visitor start while the sampled select is running and are skipped
+	// rather than taking its place
+	EXPECT_EQ(db.select_for_each("contacts", cols.begin(), cols.end(), "", none.begin(), none.end(),
+		[&db](const sql::row_view&) {
+			const std::vector<sql::column_values> call{ {"callerid", "x"}, {"contactid", 1} };
+			db.insert_into("calls", call.begin(), call.end());
+		}), SQLITE_OK);
+
+	ASSERT_TRUE(events.pop(event));
+	EXPECT_EQ(event.operation, sql::traced_operation::select_for_each);
+	EXPECT_EQ(event.sql, "SELECT name FROM contacts;");
+	EXPECT_FALSE(events.pop(event));
+}
+
+TEST_F(sqlite_cpp_tester, trace_samples_statements_and_buffer_drops_when_full) {
+	sql::sqlite db;
+	EXPECT_EQ(db.open("contacts.db"), SQLITE_OK);
+
+	sql::trace_buffer events(3);
+	EXPECT_EQ(events.capacity(), 4u);
+	EXPECT_EQ(db.set_trace(&events, 3), SQLITE_OK);
+
+	for (int i = 0; i < 30; ++i) {
+		const std::vector<sql::column_values> fields{ {"name", "contact " + std::to_string(i)} };
+		EXPECT_EQ(db.insert_into("contacts", fields.begin(), fields.end()), SQLITE_OK);
+	}
+
+	// statements 1, 4, 7 ... are sampled, 10 in all, and a full buffer keeps the oldest
+	sql::trace_event event;
+	for (int i = 0; i < 4; ++i) {
+		ASSERT_TRUE(events.pop(event));
+		EXPECT_EQ(event.operation, sql::traced_operation::insert_into);
+		EXPECT_NE(event.sql.find("'contact " + std::to_string(i * 3) + "'"), std::string::npos);
+	}
+	EXPECT_FALSE(events.pop(event));
+	EXPECT_EQ(events.dropped(), 6u);
+	db.close();
+
+	// many producers and consumers at once
+	sql::trace_buffer shared(8192);
+	std::atomic<int> popped(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&shared] {
+			for (int i = 0; i < 1000; ++i) {
+				sql::trace_event e;
+				e.nanoseconds = i;
+				e.sql = "SELECT " + std::to_string(i) + ";";
+				shared.record(std::move(e));
+			}
+		});
+		threads.emplace_back([&shared, &popped] {
+			sql::trace_event e;
+			for (int i = 0; i < 1000; ++i) {
+				if (shared.pop(e)) { ++popped; }
+			}
+		});
+	}
+	for (auto& thread : threads) {
+		thread.join();
+	}
+	while (shared.pop(event)) { ++popped; }
+	EXPECT_EQ(popped.load(), 4000);
+	EXPECT_EQ(shared.dropped(), 0u);
+}
+
 
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
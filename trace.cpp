@@ -0,0 +1,99 @@
+#include "trace.hpp"
+
+namespace sql {
+
+	const char* operation_name(traced_operation op) {
+		switch (op) {
+		case traced_operation::none: return "none";
+		case traced_operation::insert_into: return "insert_into";
+		case traced_operation::insert_many: return "insert_many";
+		case traced_operation::update: return "update";
+		case traced_operation::delete_from: return "delete_from";
+		case traced_operation::select_star: return "select_star";
+		case traced_operation::select_columns: return "select_columns";
+		case traced_operation::select_cursor: return "select_cursor";
+		case traced_operation::select_columnar: return "select_columnar";
+		case traced_operation::select_for_each: return "select_for_each";
+		case traced_operation::select_as: return "select_as";
+		case traced_operation::insert_row: return "insert_row";
+		case traced_operation::update_row: return "update_row";
+		case traced_operation::delete_row: return "delete_row";
+		case traced_operation::select_row: return "select_row";
+		case traced_operation::select_rows: return "select_rows";
+		case traced_operation::pragma: return "pragma";
+		case traced_operation::transaction: return "transaction";
+		}
+		return "unknown";
+	}
+
+	namespace {
+
+		size_t round_up_to_power_of_2(size_t n) {
+			size_t power = 1;
+			while (power < n) { power <<= 1; }
+			return power;
+		}
+
+	} // anonymous namespace
+
+	trace_buffer::trace_buffer(size_t capacity)
+		: slots_(new slot[round_up_to_power_of_2(capacity)]),
+		mask_(round_up_to_power_of_2(capacity) - 1),
+		enqueue_position_(0), dequeue_position_(0), dropped_(0) {
+		for (size_t i = 0; i <= mask_; ++i) {
+			slots_[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	void trace_buffer::record(trace_event&& event) {
+		size_t position = enqueue_position_.load(std::memory_order_relaxed);
+		slot* s = nullptr;
+		for (;;) {
+			s = &slots_[position & mask_];
+			const size_t sequence = s->sequence.load(std::memory_order_acquire);
+			const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+			if (difference == 0) {
+				// the slot is free, claim it
+				if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) { break; }
+			}
+			else if (difference < 0) {
+				// the slot still holds an event from one lap ago, the buffer is full
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			else {
+				// another producer claimed it first
+				position = enqueue_position_.load(std::memory_order_relaxed);
+			}
+		}
+
+		s->event = std::move(event);
+		s->sequence.store(position + 1, std::memory_order_release);
+	}
+
+	bool trace_buffer::pop(trace_event& event) {
+		size_t position = dequeue_position_.load(std::memory_order_relaxed);
+		slot* s = nullptr;
+		for (;;) {
+			s = &slots_[position & mask_];
+			const size_t sequence = s->sequence.load(std::memory_order_acquire);
+			const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+			if (difference == 0) {
+				if (dequeue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) { break; }
+			}
+			else if (difference < 0) {
+				// not yet written, the buffer is empty
+				return false;
+			}
+			else {
+				position = dequeue_position_.load(std::memory_order_relaxed);
+			}
+		}
+
+		event = std::move(s->event);
+		// free for the producer one lap on
+		s->sequence.store(position + mask_ + 1, std::memory_order_release);
+		return true;
+	}
+
+} // sql
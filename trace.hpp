@@ -0,0 +1,116 @@
+/*
+sqlite - a thin c++ wrapper of sqlite c library
+version 0.0.1
+https://github.com/arcomber/sqlite_cpp
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2021 Angus Comber
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace sql {
+
+	/* the wrapper call which ran a traced statement */
+	enum class traced_operation : uint8_t {
+		none,             // sql run outside any wrapper operation
+		insert_into,
+		insert_many,
+		update,
+		delete_from,
+		select_star,
+		select_columns,
+		select_cursor,
+		select_columnar,
+		select_for_each,
+		select_as,
+		insert_row,
+		update_row,
+		delete_row,
+		select_row,
+		select_rows,
+		pragma,
+		transaction
+	};
+
+	/* name of op, eg "insert_into" */
+	const char* operation_name(traced_operation op);
+
+	/* one completed statement, reported by sqlite's SQLITE_TRACE_PROFILE event */
+	struct trace_event {
+		traced_operation operation = traced_operation::none;
+		int64_t nanoseconds = 0;   // wall time sqlite measured from first step to reset
+		std::string sql;           // sqlite3_expanded_sql, bound parameters written in
+	};
+
+	/* receives the sampled events of every connection it is set on, see sqlite::set_trace.
+	record is called on the thread running the statement while sqlite holds the connection,
+	so it must be quick, must not block and must not use the connection */
+	class trace_sink {
+	public:
+		virtual ~trace_sink() = default;
+		virtual void record(trace_event&& event) = 0;
+	};
+
+	/* trace_sink holding events in a bounded lock-free queue, any number of connections may
+	record into it and any number of threads pop from it. when the queue is full new events are
+	dropped and counted, so a slow reader never holds up the statements being traced */
+	class trace_buffer : public trace_sink {
+	public:
+		/* capacity is rounded up to a power of 2 */
+		explicit trace_buffer(size_t capacity = 1024);
+
+		trace_buffer(const trace_buffer&) = delete;
+		trace_buffer& operator=(const trace_buffer&) = delete;
+
+		void record(trace_event&& event) override;
+
+		/* move the oldest event into event. false if the buffer is empty */
+		bool pop(trace_event& event);
+
+		/* events discarded because the buffer was full */
+		uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+		size_t capacity() const { return mask_ + 1; }
+
+	private:
+		// sequence tells whose turn the slot is: equal to a producer's position when free for
+		// it, position + 1 once the event is written and ready for the consumer
+		struct slot {
+			std::atomic<size_t> sequence;
+			trace_event event;
+		};
+
+		std::unique_ptr<slot[]> slots_;
+		size_t mask_;
+		// producers and consumers on separate cache lines
+		alignas(64) std::atomic<size_t> enqueue_position_;
+		alignas(64) std::atomic<size_t> dequeue_position_;
+		std::atomic<uint64_t> dropped_;
+	};
+
+} // sql
+
+#endif // TRACE_HPP_